@@ -0,0 +1,127 @@
+/* AllocationCounter.cpp
+
+   Copyright (C) 2026 by Gregory Smith
+   
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+   
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+   
+   This license is contained in the file "COPYING", which is included
+   with this source code; it is available online at
+   http://www.gnu.org/licenses/gpl.html
+   
+*/
+
+// Replaces the global allocation functions with ones that count, for
+// --stats. Only the command line tools link this; counting stays off
+// until Stats::CountAllocations, leaving a relaxed load per allocation.
+// The array and nothrow forms all come through these
+
+#include "Stats.h"
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+void count()
+{
+	if (atque::detail::count_allocations.load(std::memory_order_relaxed))
+	{
+		++atque::detail::allocation_count;
+	}
+}
+
+void* allocate(std::size_t size, std::size_t alignment)
+{
+	count();
+
+	if (size == 0)
+	{
+		size = 1;
+	}
+
+	while (true)
+	{
+		void* p;
+		if (alignment <= alignof(std::max_align_t))
+		{
+			p = std::malloc(size);
+		}
+		else
+		{
+#ifdef _WIN32
+			p = _aligned_malloc(size, alignment);
+#else
+			// aligned_alloc wants a multiple of the alignment
+			p = std::aligned_alloc(alignment, (size + alignment - 1) & ~(alignment - 1));
+#endif
+		}
+
+		if (p)
+		{
+			return p;
+		}
+
+		auto handler = std::get_new_handler();
+		if (!handler)
+		{
+			throw std::bad_alloc();
+		}
+		handler();
+	}
+}
+
+void release(void* p, std::size_t alignment)
+{
+#ifdef _WIN32
+	if (alignment > alignof(std::max_align_t))
+	{
+		_aligned_free(p);
+		return;
+	}
+#else
+	// aligned_alloc memory goes back through free like any other
+	(void) alignment;
+#endif
+	std::free(p);
+}
+
+}
+
+void* operator new(std::size_t size)
+{
+	return allocate(size, 0);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+	return allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* p) noexcept
+{
+	release(p, 0);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+	release(p, 0);
+}
+
+void operator delete(void* p, std::align_val_t alignment) noexcept
+{
+	release(p, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t alignment) noexcept
+{
+	release(p, static_cast<std::size_t>(alignment));
+}
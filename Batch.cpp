@@ -0,0 +1,220 @@
+/* Batch.cpp
+
+   Copyright (C) 2026 by Gregory Smith
+   
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+   
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+   
+   This license is contained in the file "COPYING", which is included
+   with this source code; it is available online at
+   http://www.gnu.org/licenses/gpl.html
+   
+*/
+
+#include "Batch.h"
+#include "ResourceManager.h"
+#include "ThreadPool.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+
+using namespace atque;
+namespace fs = std::filesystem;
+
+std::vector<batch_job> atque::read_manifest(std::istream& manifest)
+{
+	std::vector<batch_job> jobs;
+
+	std::string line;
+	while (std::getline(manifest, line))
+	{
+		if (line.size() && line.back() == '\r')
+		{
+			line.pop_back();
+		}
+		
+		if (line.empty() || line[0] == '#')
+		{
+			continue;
+		}
+
+		auto tab = line.find('\t');
+		if (tab == std::string::npos)
+		{
+			throw std::runtime_error("manifest line has no tab: " + line);
+		}
+
+		batch_job job;
+		job.source = fs::u8path(line.substr(0, tab));
+		job.destination = fs::u8path(line.substr(tab + 1));
+		jobs.push_back(std::move(job));
+	}
+
+	return jobs;
+}
+
+// a file, or everything under a directory, plus any AppleDouble file
+static std::uintmax_t disk_size(const fs::path& path)
+{
+	std::error_code ec;
+	std::uintmax_t size = 0;
+	if (fs::is_directory(path, ec))
+	{
+		for (auto it = fs::recursive_directory_iterator(path, ec); !ec && it != fs::recursive_directory_iterator(); it.increment(ec))
+		{
+			if (it->is_regular_file(ec))
+			{
+				size += it->file_size(ec);
+			}
+		}
+	}
+	else
+	{
+		auto file_size = fs::file_size(path, ec);
+		if (!ec)
+		{
+			size += file_size;
+		}
+
+		file_size = fs::file_size(marathon::ResourceManager::AppleDoublePath(path), ec);
+		if (!ec)
+		{
+			size += file_size;
+		}
+	}
+
+	return size;
+}
+
+static std::string json_string(const std::string& s)
+{
+	std::ostringstream out;
+	out << '"';
+	for (unsigned char c : s)
+	{
+		if (c == '"' || c == '\\')
+		{
+			out << '\\' << c;
+		}
+		else if (c < 0x20)
+		{
+			out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec;
+		}
+		else
+		{
+			out << c;
+		}
+	}
+	out << '"';
+	return out.str();
+}
+
+namespace {
+
+// how many source bytes may be in flight at once
+class ByteBudget
+{
+public:
+	explicit ByteBudget(std::uintmax_t limit) : available_(limit), limit_(limit) { }
+
+	std::uintmax_t Acquire(std::uintmax_t bytes) {
+		bytes = std::min(bytes, limit_);
+		std::unique_lock<std::mutex> lock(mutex_);
+		condition_.wait(lock, [this, bytes]() { return available_ >= bytes; });
+		available_ -= bytes;
+		return bytes;
+	}
+
+	void Release(std::uintmax_t bytes) {
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			available_ += bytes;
+		}
+		condition_.notify_all();
+	}
+
+private:
+	std::mutex mutex_;
+	std::condition_variable condition_;
+	std::uintmax_t available_;
+	std::uintmax_t limit_;
+};
+
+}
+
+int atque::run_batch(const std::vector<batch_job>& jobs,
+					 batch_fn run,
+					 std::ostream& out,
+					 std::ostream& log,
+					 const batch_options& options)
+{
+	ThreadPool pool(options.jobs);
+	ByteBudget budget(options.max_in_flight_bytes);
+	std::mutex output_mutex;
+	int failed = 0;
+
+	std::vector<std::future<void> > futures;
+	for (const auto& job : jobs)
+	{
+		auto bytes_read = disk_size(job.source);
+		auto reserved = budget.Acquire(bytes_read);
+
+		futures.push_back(pool.Submit([&, reserved, bytes_read]() {
+			std::ostringstream job_log;
+			std::string error;
+
+			auto start = std::chrono::steady_clock::now();
+			try
+			{
+				run(job, job_log);
+			}
+			catch (const std::exception& e)
+			{
+				error = e.what();
+			}
+			std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - start;
+
+			budget.Release(reserved);
+
+			auto bytes_written = error.empty() ? disk_size(job.destination) : 0;
+
+			std::ostringstream result;
+			result << "{\"source\":" << json_string(job.source.u8string())
+				   << ",\"destination\":" << json_string(job.destination.u8string())
+				   << ",\"ok\":" << (error.empty() ? "true" : "false")
+				   << ",\"seconds\":" << std::fixed << std::setprecision(3) << seconds.count()
+				   << ",\"bytes_read\":" << bytes_read
+				   << ",\"bytes_written\":" << bytes_written;
+			if (!error.empty())
+			{
+				result << ",\"error\":" << json_string(error);
+			}
+			result << "}";
+
+			std::lock_guard<std::mutex> lock(output_mutex);
+			log << job_log.str();
+			out << result.str() << std::endl;
+			if (!error.empty())
+			{
+				++failed;
+			}
+		}));
+	}
+
+	for (auto& future : futures)
+	{
+		future.get();
+	}
+
+	return failed;
+}
@@ -0,0 +1,65 @@
+/* Batch.h
+
+   Copyright (C) 2026 by Gregory Smith
+   
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+   
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+   
+   This license is contained in the file "COPYING", which is included
+   with this source code; it is available online at
+   http://www.gnu.org/licenses/gpl.html
+   
+*/
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace atque
+{
+
+struct batch_job {
+	std::filesystem::path source;
+	std::filesystem::path destination;
+};
+
+struct batch_options {
+	// jobs run at once
+	int jobs = 1;
+
+	// jobs only start while the sources of those already running add up
+	// to less than this; a job bigger than the limit runs alone
+	std::uintmax_t max_in_flight_bytes = std::uintmax_t{1} << 30;
+};
+
+// one job per line: source and destination separated by a tab; blank
+// lines and lines starting with # are skipped
+std::vector<batch_job> read_manifest(std::istream& manifest);
+
+// runs every job on a shared pool and writes one JSON line per job to
+// out as it finishes, with its time and the bytes in its source and
+// destination; each job's log goes to log when it's done. Returns the
+// number of jobs that failed
+using batch_fn = std::function<void(const batch_job& job, std::ostream& log)>;
+int run_batch(const std::vector<batch_job>& jobs,
+			  batch_fn run,
+			  std::ostream& out,
+			  std::ostream& log,
+			  const batch_options& options = batch_options());
+
+}
+
+#endif
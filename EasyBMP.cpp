@@ -137,9 +137,60 @@ RGBApixel BMP::GetPixel( int i, int j ) const
 bool BMP::SetPixel( int i, int j, RGBApixel NewPixel )
 {
  Pixels[i][j] = NewPixel;
+ if( !Indices.empty() )
+ { Indices[j*Width+i] = FindClosestColor( NewPixel ); }
  return true;
 }
 
+// copies a whole row of Width pixels, left to right
+bool BMP::GetRow( int Row, RGBApixel* Output ) const
+{
+ if( Row < 0 || Row >= Height )
+ { return false; }
+ for( int i=0 ; i < Width ; i++ )
+ { Output[i] = Pixels[i][Row]; }
+ return true;
+}
+
+bool BMP::SetRow( int Row, const RGBApixel* Input )
+{
+ if( Row < 0 || Row >= Height )
+ { return false; }
+ for( int i=0 ; i < Width ; i++ )
+ { Pixels[i][Row] = Input[i]; }
+ if( !Indices.empty() )
+ {
+  for( int i=0 ; i < Width ; i++ )
+  { Indices[Row*Width+i] = FindClosestColor( Pixels[i][Row] ); }
+ }
+ return true;
+}
+
+bool BMP::GetIndexRow( int Row, ebmpBYTE* Output ) const
+{
+ if( Row < 0 || Row >= Height || Indices.empty() )
+ { return false; }
+ memcpy( Output , &Indices[Row*Width] , Width );
+ return true;
+}
+
+bool BMP::SetIndexRow( int Row, const ebmpBYTE* Input )
+{
+ if( Row < 0 || Row >= Height || BitDepth > 8 )
+ { return false; }
+ if( Indices.empty() )
+ { Indices.assign( Width*Height , 0 ); }
+ memcpy( &Indices[Row*Width] , Input , Width );
+ return true;
+}
+
+ebmpBYTE BMP::IndexAt( int i, int Row )
+{
+ if( Indices.empty() )
+ { return FindClosestColor( Pixels[i][Row] ); }
+ return Indices[Row*Width+i];
+}
+
 
 bool BMP::SetColor( int ColorNumber , RGBApixel NewColor )
 {
@@ -174,6 +225,8 @@ bool BMP::SetColor( int ColorNumber , RGBApixel NewColor )
   return false;
  }
  Colors[ColorNumber] = NewColor;
+ // the pixels keep their colors, so they're written by color again
+ Indices.clear();
  return true;
 }
 
@@ -290,6 +343,8 @@ BMP::BMP( BMP& Input )
 //   Pixels[i][j] = Input.GetPixel(i,j); // *Input(i,j);
   }
  }
+ 
+ Indices = Input.Indices;
 }
 
 BMP::~BMP()
@@ -376,6 +431,7 @@ bool BMP::SetBitDepth( int NewDepth )
  { Colors = NULL; } 
  if( BitDepth == 1 || BitDepth == 4 || BitDepth == 8 )
  { CreateStandardColorTable(); }
+ Indices.clear();
  
  return true;
 }
@@ -417,6 +473,8 @@ bool BMP::SetSize(int NewWidth , int NewHeight )
    Pixels[i][j].Alpha = 0;    
   }
  }
+ 
+ Indices.clear();
 
  return true; 
 }
@@ -935,6 +993,8 @@ bool BMP::ReadFromFile( const char* FileName )
   { BufferSize++; }
   ebmpBYTE* Buffer;
   Buffer = new ebmpBYTE [BufferSize];
+  if( BitDepth <= 8 )
+  { Indices.assign( Width*Height , 0 ); }
   j= Height-1;
   while( j > -1 )
   {
@@ -1589,6 +1649,7 @@ bool BMP::Read8bitRow(  ebmpBYTE* Buffer, int BufferSize, int Row )
  {
   int Index = Buffer[i];
   *( this->operator()(i,Row) )= GetColor(Index); 
+  Indices[Row*Width+i] = (ebmpBYTE) Index;
  }
  return true;
 }
@@ -1610,6 +1671,7 @@ bool BMP::Read4bitRow(  ebmpBYTE* Buffer, int BufferSize, int Row )
   {
    int Index = (int) ( (Buffer[k]&Masks[j]) >> Shifts[j]);
    *( this->operator()(i,Row) )= GetColor(Index); 
+   Indices[Row*Width+i] = (ebmpBYTE) Index;
    i++; j++;   
   }
   k++;
@@ -1634,6 +1696,7 @@ bool BMP::Read1bitRow(  ebmpBYTE* Buffer, int BufferSize, int Row )
   {
    int Index = (int) ( (Buffer[k]&Masks[j]) >> Shifts[j]);
    *( this->operator()(i,Row) )= GetColor(Index); 
+   Indices[Row*Width+i] = (ebmpBYTE) Index;
    i++; j++;   
   }
   k++;
@@ -1667,7 +1730,7 @@ bool BMP::Write8bitRow(  ebmpBYTE* Buffer, int BufferSize, int Row )
  if( Width > BufferSize )
  { return false; }
  for( i=0 ; i < Width ; i++ )
- { Buffer[i] = FindClosestColor( Pixels[i][Row] ); }
+ { Buffer[i] = IndexAt( i, Row ); }
  return true;
 }
 
@@ -1686,7 +1749,7 @@ bool BMP::Write4bitRow(  ebmpBYTE* Buffer, int BufferSize, int Row )
   int Index = 0;
   while( j < 2 && i < Width )
   {
-   Index += ( PositionWeights[j]* (int) FindClosestColor( Pixels[i][Row] ) ); 
+   Index += ( PositionWeights[j]* (int) IndexAt( i, Row ) ); 
    i++; j++;   
   }
   Buffer[k] = (ebmpBYTE) Index;
@@ -1710,7 +1773,7 @@ bool BMP::Write1bitRow(  ebmpBYTE* Buffer, int BufferSize, int Row )
   int Index = 0;
   while( j < 8 && i < Width )
   {
-   Index += ( PositionWeights[j]* (int) FindClosestColor( Pixels[i][Row] ) ); 
+   Index += ( PositionWeights[j]* (int) IndexAt( i, Row ) ); 
    i++; j++;   
   }
   Buffer[k] = (ebmpBYTE) Index;
@@ -22,6 +22,7 @@
 #define _EasyBMP_BMP_h_
 
 #include <map>
+#include <vector>
 
 bool SafeFread( char* buffer, int size, int number, FILE* fp );
 bool EasyBMPcheckDataSize( void );
@@ -57,6 +58,11 @@ class BMP
  ebmpBYTE FindClosestColor( RGBApixel& input );
  std::map<RGBApixel, ebmpBYTE> ClosestColorMap;
 
+ // palette indices, row-major; empty unless read from a 1, 4 or 8-bit
+ // file or set with SetIndexRow
+ std::vector<ebmpBYTE> Indices;
+ ebmpBYTE IndexAt( int i, int Row );
+
  public: 
 
  int TellBitDepth( void );
@@ -70,11 +76,23 @@ class BMP
  BMP();
  BMP( BMP& Input );
  ~BMP();
+ // write access through this skips the palette indices below, so an
+ // image read from an indexed file should be changed with SetPixel or
+ // SetRow
  RGBApixel* operator()(int i,int j);
  
  RGBApixel GetPixel( int i, int j ) const;
  bool SetPixel( int i, int j, RGBApixel NewPixel );
  
+ bool GetRow( int Row, RGBApixel* Output ) const;
+ bool SetRow( int Row, const RGBApixel* Input );
+ 
+ // palette indices of 1, 4 and 8-bit images; once set, these are
+ // written as they are, instead of the closest color to each pixel.
+ // SetPixel and SetRow keep them up to date, and SetColor drops them
+ bool GetIndexRow( int Row, ebmpBYTE* Output ) const;
+ bool SetIndexRow( int Row, const ebmpBYTE* Input );
+ 
  bool CreateStandardColorTable( void );
  
  bool SetSize( int NewWidth, int NewHeight );
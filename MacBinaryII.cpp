@@ -20,13 +20,43 @@
 
 #include "MacBinaryII.h"
 
-#include <boost/crc.hpp>
+namespace {
+
+// CRC-16/XMODEM (polynomial 0x1021, MSB first), a byte at a time
+struct CRC16Table
+{
+	constexpr CRC16Table() : entries() {
+		for (auto i = 0; i < 256; ++i)
+		{
+			uint16_t crc = i << 8;
+			for (auto bit = 0; bit < 8; ++bit)
+			{
+				crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+			}
+			entries[i] = crc;
+		}
+	}
+
+	uint16_t entries[256];
+};
+
+constexpr CRC16Table crc16_table;
+
+}
+
+uint16_t MacBinaryII::CRC16(const uint8_t* data, std::size_t size, uint16_t crc)
+{
+	for (std::size_t i = 0; i < size; ++i)
+	{
+		crc = (crc << 8) ^ crc16_table.entries[(crc >> 8) ^ data[i]];
+	}
+
+	return crc;
+}
 
 uint16_t MacBinaryII::CalculateCRC() const
 {
-	boost::crc_optimal<16, 0x1021, 0, 0, false, false> crc_algorithm;
-	crc_algorithm.process_bytes(this, 124);
-	return crc_algorithm.checksum();
+	return CRC16(reinterpret_cast<const uint8_t*>(this), 124);
 }
 
 bool MacBinaryII::IsValid() const
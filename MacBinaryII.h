@@ -21,6 +21,9 @@
 #ifndef MACBINARYII_H
 #define MACBINARYII_H
 
+#include <cstddef>
+#include <cstdint>
+
 #include <boost/endian.hpp>
 
 struct MacBinaryII
@@ -61,6 +64,8 @@ struct MacBinaryII
 
 	uint16_t CalculateCRC() const;
 	bool IsValid() const;
+
+	static uint16_t CRC16(const uint8_t* data, std::size_t size, uint16_t crc = 0);
 };
 
 static_assert(sizeof(MacBinaryII) == 128);
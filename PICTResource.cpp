@@ -19,8 +19,11 @@
 */
 
 #include "ferro/AStream.h"
+#include "PackBits.h"
 #include "PICTResource.h"
+#include "PixelFormats.h"
 
+#include <algorithm>
 #include <bitset>
 #include <fstream>
 #include <sstream>
@@ -51,9 +54,46 @@ void PICTResource::Load(const std::vector<uint8>& data)
 	stream.read(&data_[0], data_.size());
 }*/
 
+// EasyBMP's default 8-bit palette, for indexed images that don't
+// replace every entry
+static const std::vector<RGBApixel>& StandardPalette()
+{
+	static const std::vector<RGBApixel> palette = [] {
+		BMP bmp;
+		bmp.SetBitDepth(8);
+		std::vector<RGBApixel> result(256);
+		for (int i = 0; i < 256; ++i)
+		{
+			result[i] = bmp.GetColor(i);
+		}
+		return result;
+	}();
+
+	return palette;
+}
+
+void PICTResource::SetImage(int width, int height, int depth)
+{
+	width_ = width;
+	height_ = height;
+	depth_ = depth;
+	pixels_.assign(static_cast<std::size_t>(width) * height * PixelBytes(), 0);
+	if (depth == 8)
+		palette_ = StandardPalette();
+	else
+		palette_.clear();
+}
+
+void PICTResource::ClearImage()
+{
+	width_ = height_ = depth_ = 0;
+	pixels_.clear();
+	palette_.clear();
+}
+
 void PICTResource::Load(const std::vector<uint8>& data)
 {
-	bitmap_.SetSize(1, 1);
+	ClearImage();
 	data_.clear();
 	jpeg_.clear();
 	AIStreamBE stream(&data[0], data.size());
@@ -167,9 +207,9 @@ void PICTResource::Load(const std::vector<uint8>& data)
 				LoadCopyBits(stream, packed, clipped);
 				if (jpeg_.size())
 				{
-					bitmap_.SetSize(1, 1);
+					ClearImage();
 				}
-				else if (bitmap_.TellWidth() != rect.width() && bitmap_.TellWidth() == 614)
+				else if (width_ != rect.width() && width_ == 614)
 					
 				{
 					throw ParseError("PICT appears to use Cinemascope hack");
@@ -203,24 +243,27 @@ void PICTResource::Load(const std::vector<uint8>& data)
 	}
 	catch (const ParseError& e)
 	{
-		bitmap_.SetSize(1, 1);
+		ClearImage();
 		jpeg_.clear();
 		data_ = data;
 		why_unparsed_ = e.what();
 	}
 	catch (const AStream::failure& e)
 	{
-		bitmap_.SetSize(1, 1);
+		ClearImage();
 		jpeg_.clear();
 		data_ = data;
 		why_unparsed_ = "Error parsing PICT";
 	}
 }
 
+// unpacks one row into scan_line, which is already as long as a row can
+// be; false if the row doesn't fit. scan_line is reused from row to row,
+// so a row that comes up short of the needed elements is padded with
+// zeros rather than keep the end of the row before
 template <class T>
-static std::vector<T> UnpackRow(AIStreamBE& stream, int row_bytes)
+static bool UnpackRow(AIStreamBE& stream, int row_bytes, std::vector<T>& scan_line, std::size_t needed)
 {
-	std::vector<T> result;
 	int row_length;
 	if (row_bytes > 250)
 	{
@@ -235,35 +278,19 @@ static std::vector<T> UnpackRow(AIStreamBE& stream, int row_bytes)
 		row_length = length;
 	}
 
-	uint32 end = stream.tellg() + row_length;
-	while (stream.tellg() < end)
+	std::size_t unpacked;
+	if (!UnpackBits(stream.view(row_length), row_length, scan_line.data(), scan_line.size(), unpacked))
 	{
-		int8 c;
-		stream >> c;
+		return false;
+	}
 
-		if (c < 0)
-		{
-			int size = -c + 1;
-			T data;
-			stream >> data;
-			for (int i = 0; i < size; ++i)
-			{
-				result.push_back(data);
-			}
-		}
-		else if (c != -128)
-		{
-			int size = c + 1;
-			T data;
-			for (int i = 0; i < size; ++i)
-			{
-				stream >> data;
-				result.push_back(data);
-			}
-		}
+	needed = std::min(needed, scan_line.size());
+	if (unpacked < needed)
+	{
+		std::fill(scan_line.begin() + unpacked, scan_line.begin() + needed, 0);
 	}
-	
-	return result;
+
+	return true;
 }
 
 static std::vector<uint8> ExpandPixels(const std::vector<uint8>& scan_line, int depth)
@@ -325,11 +352,7 @@ void PICTResource::LoadCopyBits(AIStreamBE& stream, bool packed, bool clipped)
 		pixel_size = 1;
 	}
 
-	bitmap_.SetSize(width, height);
-	if (pixel_size <= 8)
-		bitmap_.SetBitDepth(8);
-	else
-		bitmap_.SetBitDepth(pixel_size);
+	SetImage(width, height, pixel_size <= 8 ? 8 : pixel_size);
 	
 	// read the color table
 	if (is_pixmap && packed)
@@ -353,7 +376,8 @@ void PICTResource::LoadCopyBits(AIStreamBE& stream, bool packed, bool clipped)
 				index &= 0xff;
 
 			RGBApixel pixel = { static_cast<ebmpBYTE>(blue >> 8), static_cast<ebmpBYTE>(green >> 8), static_cast<ebmpBYTE>(red >> 8), 0xff };
-			bitmap_.SetColor(index, pixel);
+			if (index < palette_.size())
+				palette_[index] = pixel;
 		}
 	}
 
@@ -371,79 +395,56 @@ void PICTResource::LoadCopyBits(AIStreamBE& stream, bool packed, bool clipped)
 	// the picture itself
 	if (pixel_size <= 8)
 	{
+		std::vector<uint8> scan_line(pixel_size == 8 ? std::max<int>(row_bytes, width) : row_bytes);
 		for (int y = 0; y < height; ++y)
 		{
-			std::vector<uint8> scan_line;
 			if (row_bytes < 8)
 			{
-				scan_line.resize(row_bytes);
-				stream.read(&scan_line[0], scan_line.size());
+				stream.read(&scan_line[0], row_bytes);
 			}
-			else
+			else if (!UnpackRow(stream, row_bytes, scan_line, (width * pixel_size + 7) / 8))
 			{
-				scan_line = UnpackRow<uint8>(stream, row_bytes);
+				throw ParseError("PICT scan line is longer than its row");
 			}
 
 			if (pixel_size == 8)
 			{
-				for (int x = 0; x < width; ++x)
-				{
-					bitmap_.SetPixel(x, y, bitmap_.GetColor(scan_line[x]));
-				}
+				memcpy(Row(y), &scan_line[0], width);
 			}
 			else
 			{
 				std::vector<uint8> pixels = ExpandPixels(scan_line, pixel_size);
-				
-				for (int x = 0; x < width; ++x)
-				{
-					bitmap_.SetPixel(x, y, bitmap_.GetColor(pixels[x]));
-				}
+				memcpy(Row(y), &pixels[0], std::min<std::size_t>(width, pixels.size()));
 			}
 		}		
 	}
 	else if (pixel_size == 16)
 	{
+		std::vector<uint16> scan_line(std::max<int>(row_bytes / 2, width));
 		for (int y = 0; y < height; ++y)
 		{
-			std::vector<uint16> scan_line;
 			if (row_bytes < 8 || pack_type == 1)
 			{
-				for (int x = 0; x < width; ++x)
-				{
-					uint16 pixel;
-					stream >> pixel;
-					scan_line.push_back(pixel);
-				}
+				stream.read(&scan_line[0], width);
 			}
 			else if (pack_type == 0 || pack_type == 3)
 			{
-				scan_line = UnpackRow<uint16>(stream, row_bytes);
+				if (!UnpackRow(stream, row_bytes, scan_line, width))
+				{
+					throw ParseError("PICT scan line is longer than its row");
+				}
 			}
 
-			for (int x = 0; x < width; ++x)
-			{
-				RGBApixel pixel;
-				pixel.Red = (scan_line[x] >> 10) & 0x1f;
-				pixel.Green = (scan_line[x] >> 5) & 0x1f;
-				pixel.Blue = scan_line[x] & 0x1f;
-				pixel.Red = (pixel.Red * 255 + 16) / 31;
-				pixel.Green = (pixel.Green * 255 + 16) / 31;
-				pixel.Blue = (pixel.Blue * 255 + 16) / 31;
-				pixel.Alpha = 0xff;
-				
-				bitmap_.SetPixel(x, y, pixel);
-			}
+			ExpandRGB555(&scan_line[0], width, Row(y));
 		}
 	}
 	else if (pixel_size == 32)
 	{
+		std::vector<uint8> scan_line(std::max<int>(row_bytes, width * 3));
 		for (int y = 0; y < height; ++y)
 		{
-			std::vector<uint8> scan_line;
 			if (row_bytes < 8 || pack_type == 1)
 			{
-				scan_line.resize(width * 3);
 				for (int x = 0; x < width; ++x)
 				{
 					uint32 pixel;
@@ -455,18 +456,13 @@ void PICTResource::LoadCopyBits(AIStreamBE& stream, bool packed, bool clipped)
 			}
 			else if (pack_type == 0 || pack_type == 4)
 			{
-				scan_line = UnpackRow<uint8>(stream, row_bytes);
+				if (!UnpackRow(stream, row_bytes, scan_line, width * 3))
+				{
+					throw ParseError("PICT scan line is longer than its row");
+				}
 			}
 
-			for (int x = 0; x < width; ++x)
-			{
-				RGBApixel pixel;
-				pixel.Red = scan_line[x];
-				pixel.Green = scan_line[x + width];
-				pixel.Blue = scan_line[x + width * 2];
-				pixel.Alpha = 0xff;
-				bitmap_.SetPixel(x, y, pixel);
-			}
+			InterleaveRGB(&scan_line[0], width, Row(y));
 		}
 	}
 					
@@ -533,70 +529,6 @@ void PICTResource::LoadJPEG(AIStreamBE& stream)
 	stream.ignore(opcode_start + opcode_size - stream.tellg());
 }
 
-template <class T>
-static std::vector<uint8> PackRow(const std::vector<T>& scan_line)
-{
-	std::vector<uint8> result(scan_line.size() * sizeof(T) * 2);
-	AOStreamBE stream(&result[0], result.size());
-
-	typename std::vector<T>::const_iterator run = scan_line.begin();
-	typename std::vector<T>::const_iterator start = scan_line.begin();
-	typename std::vector<T>::const_iterator end = scan_line.begin() + 1;
-
-	while (end != scan_line.end())
-	{
-		if (*end != *(end - 1))
-		{
-			run = end;
-		}
-		
-		end++;
-		if (end - run == 3)
-		{
-			if (run > start)
-			{
-				uint8 block_length = run - start - 1;
-				stream << block_length;
-				while (start < run)
-				{
-					stream << *start++;
-				}
-			}
-			while (end != scan_line.end() && *end == *(end - 1) && end - run < 128)
-			{
-				++end;
-			}
-			uint8 run_length = 1 - (end - run);
-			stream << run_length;
-			stream << *run;
-			run = end;
-			start = end;
-		}
-		else if (end - start == 128)
-		{
-			uint8 block_length = end - start - 1;
-			stream << block_length;
-			while (start < end)
-			{
-				stream << *start++;
-			}
-			run = end;
-		}
-	}
-	if (end > start)
-	{
-		uint8 block_length = end - start - 1;
-		stream << block_length;
-		while (start < end)
-		{
-			stream << *start++;
-		}
-	}
-
-	result.resize(stream.tellp());
-	return result;
-}
-
 bool PICTResource::LoadRaw(const std::vector<uint8>& data, const std::vector<uint8>& clut)
 {
 	AIStreamBE stream(&data[0], data.size());
@@ -613,8 +545,7 @@ bool PICTResource::LoadRaw(const std::vector<uint8>& data, const std::vector<uin
 	if (depth != 8 && depth != 16)
 		return false;
 
-	bitmap_.SetBitDepth(depth);	
-	bitmap_.SetSize(width, height);
+	SetImage(width, height, depth);
 
 	if (depth == 8)
 	{
@@ -631,37 +562,17 @@ bool PICTResource::LoadRaw(const std::vector<uint8>& data, const std::vector<uin
 				    >> blue;
 
 			RGBApixel color = { static_cast<ebmpBYTE>(blue >> 8), static_cast<ebmpBYTE>(green >> 8), static_cast<ebmpBYTE>(red >> 8), 0xff };
-			bitmap_.SetColor(i, color);
-		}
-		for (int y = 0; y < height; ++y)
-		{
-			for (int x = 0; x < width; ++x)
-			{
-				uint8 pixel;
-				stream >> pixel;
-				bitmap_.SetPixel(x, y, bitmap_.GetColor(pixel));
-			}
+			palette_[i] = color;
 		}
+		stream.read(&pixels_[0], pixels_.size());
 	}
 	else
 	{
+		std::vector<uint16> row(width);
 		for (int y = 0; y < height; ++y)
 		{
-			for (int x = 0; x < width; ++x)
-			{
-				uint16 color;
-				stream >> color;
-				RGBApixel pixel;
-				pixel.Red = (color >> 10) & 0x1f;
-				pixel.Green = (color >> 5) & 0x1f;
-				pixel.Blue = color & 0x1f;
-				pixel.Red = (pixel.Red * 255 + 16) / 31;
-				pixel.Green = (pixel.Green * 255 + 16) / 31;
-				pixel.Blue = (pixel.Blue * 255 + 16) / 31;
-				pixel.Alpha = 0xff;
-				
-				bitmap_.SetPixel(x, y, pixel);
-			}
+			stream.read(row.data(), width);
+			ExpandRGB555(row.data(), width, Row(y));
 		}
 	}
 
@@ -672,13 +583,9 @@ std::vector<uint8> PICTResource::SaveBMP() const
 {
 	std::vector<uint8> result;
 	
-	int depth = const_cast<BMP&>(bitmap_).TellBitDepth();
-	int width = const_cast<BMP&>(bitmap_).TellWidth();
-	int height = const_cast<BMP&>(bitmap_).TellHeight();
-	if (depth < 8) 
-		depth = 8;
-	else if (depth == 24)
-		depth = 32;
+	int depth = depth_;
+	int width = width_;
+	int height = height_;
 	
 	// size(2), rect(8), versionOp(2), version(2), headerOp(26), clip(12)
 	int output_length = 10 + 2 + 2 + HeaderOp::kSize + 12;
@@ -755,7 +662,7 @@ std::vector<uint8> PICTResource::SaveBMP() const
 
 		for (int16 index = 0; index < 256; ++index)
 		{
-			RGBApixel pixel = const_cast<BMP&>(bitmap_).GetColor(index);
+			RGBApixel pixel = palette_[index];
 			uint16 red = pixel.Red << 8;
 			uint16 green = pixel.Green << 8;
 			uint16 blue = pixel.Blue << 8;
@@ -775,60 +682,37 @@ std::vector<uint8> PICTResource::SaveBMP() const
 	int16 transfer_mode = 0;
 	ostream << transfer_mode;
 
-	std::map<RGBApixel, int> color_map; // for faster saving of 8-bit images
-	if (depth == 8)
-	{
-		for (int i = 255; i >= 0; --i)
-		{
-			color_map[const_cast<BMP&>(bitmap_).GetColor(i)] = i;
-		}
-	}
+	// indexed rows pack straight from the image; direct color rows are
+	// rearranged into one of these first
+	std::vector<uint8> pixels8(depth == 32 ? width * 3 : 0);
+	std::vector<uint16> pixels16(depth == 16 ? width : 0);
+	std::vector<uint8> scan_line(depth == 16 ? PackBitsBound<uint16>(width) : PackBitsBound<uint8>(depth == 8 ? width : width * 3));
 
 	for (int y = 0; y < height; ++y)
 	{
-		std::vector<uint8> scan_line;
+		std::size_t packed;
+		const uint8* row = Row(y);
 		if (depth == 8)
 		{
-			std::vector<uint8> pixels(width);
-			for (int x = 0; x < width; ++x)
-			{
-				pixels[x] = color_map[bitmap_.GetPixel(x, y)];
-			}
-
-			scan_line = PackRow(pixels);
+			packed = PackBits(row, width, scan_line.data());
 		}
 		else if (depth == 16)
 		{
-			std::vector<uint16> pixels(width);
-			for (int x = 0; x < width; ++x)
-			{
-				uint16 red = bitmap_.GetPixel(x, y).Red >> 3;
-				uint16 green = bitmap_.GetPixel(x, y).Green >> 3;
-				uint16 blue = bitmap_.GetPixel(x, y).Blue >> 3;
-				pixels[x] = (red << 10) | (green << 5) | blue;
-			}
-
-			scan_line = PackRow(pixels);
+			PackRGB555(row, width, pixels16.data());
+			packed = PackBits(pixels16.data(), pixels16.size(), scan_line.data());
 		}
 		else
 		{
-			std::vector<uint8> pixels(width * 3);
-			for (int x = 0; x < width; ++x)
-			{
-				pixels[x] = bitmap_.GetPixel(x, y).Red;
-				pixels[x + width] = bitmap_.GetPixel(x, y).Green;
-				pixels[x + width * 2] = bitmap_.GetPixel(x, y).Blue;
-			}
-
-			scan_line = PackRow(pixels);
+			DeinterleaveRGB(row, width, pixels8.data());
+			packed = PackBits(pixels8.data(), pixels8.size(), scan_line.data());
 		}
 
 		if (row_bytes > 250)
-			ostream << static_cast<uint16>(scan_line.size());
+			ostream << static_cast<uint16>(packed);
 		else
-			ostream << static_cast<uint8>(scan_line.size());
+			ostream << static_cast<uint8>(packed);
 	
-		ostream.write(&scan_line[0], scan_line.size());
+		ostream.write(&scan_line[0], packed);
 	}
 
 	if (ostream.tellp() & 1)
@@ -1036,7 +920,7 @@ std::vector<uint8> PICTResource::SaveJPEG() const
 
 std::vector<uint8> PICTResource::Save() const
 {
-	if (const_cast<BMP&>(bitmap_).TellHeight() != 1 || const_cast<BMP&>(bitmap_).TellWidth() != 1)
+	if (pixels_.size())
 	{
 		return SaveBMP();
 	}
@@ -1052,11 +936,47 @@ std::vector<uint8> PICTResource::Save() const
 
 bool PICTResource::Import(const std::filesystem::path& path)
 {
+	ClearImage();
 	data_.clear();
 	jpeg_.clear();
 	if (path.extension() == ".bmp")
 	{
-		bitmap_.ReadFromFile(path.c_str());
+		BMP bitmap;
+		if (!bitmap.ReadFromFile(path.c_str()))
+			return false;
+
+		int depth = bitmap.TellBitDepth();
+		SetImage(bitmap.TellWidth(), bitmap.TellHeight(), depth <= 8 ? 8 : (depth == 16 ? 16 : 32));
+
+		if (depth_ == 8)
+		{
+			// unused entries are white, as GetColor would have it
+			RGBApixel white = { 0xff, 0xff, 0xff, 0 };
+			for (int i = 0; i < 256; ++i)
+			{
+				palette_[i] = (i < bitmap.TellNumberOfColors()) ? bitmap.GetColor(i) : white;
+			}
+
+			for (int y = 0; y < height_; ++y)
+			{
+				bitmap.GetIndexRow(y, Row(y));
+			}
+		}
+		else
+		{
+			std::vector<RGBApixel> row(width_);
+			for (int y = 0; y < height_; ++y)
+			{
+				bitmap.GetRow(y, &row[0]);
+				uint8* pixels = Row(y);
+				for (int x = 0; x < width_; ++x)
+				{
+					*pixels++ = row[x].Red;
+					*pixels++ = row[x].Green;
+					*pixels++ = row[x].Blue;
+				}
+			}
+		}
 	}
 	else if (path.extension() == ".jpg")
 	{
@@ -1082,12 +1002,46 @@ bool PICTResource::Import(const std::filesystem::path& path)
 	return true;
 }
 
-void PICTResource::Export(const std::filesystem::path& path)
+std::filesystem::path PICTResource::Export(const std::filesystem::path& path)
 {
-	if (bitmap_.TellHeight() != 1 || bitmap_.TellWidth() != 1)
+	if (pixels_.size())
 	{
+		BMP bitmap;
+		bitmap.SetSize(width_, height_);
+		bitmap.SetBitDepth(depth_);
+
+		if (depth_ == 8)
+		{
+			for (int i = 0; i < 256; ++i)
+			{
+				bitmap.SetColor(i, palette_[i]);
+			}
+
+			for (int y = 0; y < height_; ++y)
+			{
+				bitmap.SetIndexRow(y, Row(y));
+			}
+		}
+		else
+		{
+			std::vector<RGBApixel> row(width_);
+			for (int y = 0; y < height_; ++y)
+			{
+				const uint8* pixels = Row(y);
+				for (int x = 0; x < width_; ++x, pixels += 3)
+				{
+					row[x].Red = pixels[0];
+					row[x].Green = pixels[1];
+					row[x].Blue = pixels[2];
+					row[x].Alpha = 0xff;
+				}
+				bitmap.SetRow(y, &row[0]);
+			}
+		}
+
 		std::string bmp_path = path.string() + ".bmp";
-		bitmap_.WriteToFile(bmp_path.c_str());
+		bitmap.WriteToFile(bmp_path.c_str());
+		return bmp_path;
 	}
 	else if (jpeg_.size())
 	{
@@ -1095,6 +1049,7 @@ void PICTResource::Export(const std::filesystem::path& path)
 		jpeg_path += ".jpg";
 		std::ofstream outfile(jpeg_path, std::ios::trunc | std::ios::binary);
 		outfile.write(reinterpret_cast<const char *>(&jpeg_[0]), jpeg_.size());
+		return jpeg_path;
 	}
 	else
 	{
@@ -1109,6 +1064,7 @@ void PICTResource::Export(const std::filesystem::path& path)
 
 		std::vector<uint8> pict = Save();
 		outfile.write(reinterpret_cast<const char*>(&pict[0]), pict.size());
+		return pict_path;
 	}
 }
 
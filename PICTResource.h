@@ -44,9 +44,11 @@ namespace atque
 		std::vector<uint8> Save() const;
 
 		bool Import(const std::filesystem::path& path);
-		void Export(const std::filesystem::path& path);
+		// adds the extension for whatever format it ends up in, and
+		// returns the path written
+		std::filesystem::path Export(const std::filesystem::path& path);
 
-		bool IsUnparsed() { return bitmap_.TellHeight() == 1 && bitmap_.TellWidth() == 1 && jpeg_.size() == 0; }
+		bool IsUnparsed() { return pixels_.empty() && jpeg_.size() == 0; }
 		std::string WhyUnparsed() { return why_unparsed_; }
 
 		struct Rect
@@ -71,7 +73,20 @@ namespace atque
 		void LoadJPEG(AIStreamBE& stream);
 		std::vector<uint8> SaveJPEG() const;
 		std::vector<uint8> SaveBMP() const;
-		BMP bitmap_;
+
+		// depth is 8 for indexed images, or 16/32 for direct color ones,
+		// which are stored as R, G, B bytes regardless
+		void SetImage(int width, int height, int depth);
+		void ClearImage();
+		int PixelBytes() const { return depth_ == 8 ? 1 : 3; }
+		uint8* Row(int y) { return pixels_.data() + static_cast<std::size_t>(y) * width_ * PixelBytes(); }
+		const uint8* Row(int y) const { return pixels_.data() + static_cast<std::size_t>(y) * width_ * PixelBytes(); }
+
+		int width_ = 0;
+		int height_ = 0;
+		int depth_ = 0;
+		std::vector<uint8> pixels_; // row-major, top to bottom
+		std::vector<RGBApixel> palette_; // 256 entries, when depth_ is 8
 
 		class ParseError : public std::runtime_error
 		{
@@ -0,0 +1,340 @@
+/* PackBits.cpp
+
+   Copyright (C) 2026 by Gregory Smith
+   
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+   
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+   
+   This license is contained in the file "COPYING", which is included
+   with this source code; it is available online at
+   http://www.gnu.org/licenses/gpl.html
+   
+*/
+
+#include "PackBits.h"
+#include "ferro/AStream.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include <boost/endian.hpp>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+using namespace atque;
+
+namespace {
+
+// a repeat run: broadcast the value and store 16 bytes at a time; runs
+// are at most 129 elements, so there's no point aligning first
+void fill(uint8_t* dst, uint8_t value, std::size_t count)
+{
+	std::size_t i = 0;
+#if defined(__SSE2__)
+	auto v = _mm_set1_epi8(static_cast<char>(value));
+	for (; i + 16 <= count; i += 16)
+	{
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), v);
+	}
+#elif defined(__ARM_NEON)
+	auto v = vdupq_n_u8(value);
+	for (; i + 16 <= count; i += 16)
+	{
+		vst1q_u8(dst + i, v);
+	}
+#endif
+	for (; i < count; ++i)
+	{
+		dst[i] = value;
+	}
+}
+
+void fill(uint16_t* dst, uint16_t value, std::size_t count)
+{
+	std::size_t i = 0;
+#if defined(__SSE2__)
+	auto v = _mm_set1_epi16(static_cast<short>(value));
+	for (; i + 8 <= count; i += 8)
+	{
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), v);
+	}
+#elif defined(__ARM_NEON)
+	auto v = vdupq_n_u16(value);
+	for (; i + 8 <= count; i += 8)
+	{
+		vst1q_u16(dst + i, v);
+	}
+#endif
+	for (; i < count; ++i)
+	{
+		dst[i] = value;
+	}
+}
+
+// the run scans need a movemask, which 32-bit NEON can't do cheaply
+#if defined(__SSE2__) || (defined(__ARM_NEON) && defined(__aarch64__))
+#define VECTOR_SCAN 1
+#endif
+
+// whether each of the 16 elements at src equals the one after it, a bit
+// each
+#if defined(__SSE2__)
+unsigned equal_mask(const uint8_t* src)
+{
+	auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+	auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 1));
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(a, b));
+}
+
+unsigned equal_mask(const uint16_t* src)
+{
+	auto a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+	auto b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 1));
+	auto a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 8));
+	auto b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 9));
+	return _mm_movemask_epi8(_mm_packs_epi16(_mm_cmpeq_epi16(a0, b0), _mm_cmpeq_epi16(a1, b1)));
+}
+#elif defined(VECTOR_SCAN)
+unsigned movemask(uint8x16_t v)
+{
+	static const uint8_t weights[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+	auto bits = vandq_u8(v, vld1q_u8(weights));
+	return vaddv_u8(vget_low_u8(bits)) | (vaddv_u8(vget_high_u8(bits)) << 8);
+}
+
+unsigned equal_mask(const uint8_t* src)
+{
+	return movemask(vceqq_u8(vld1q_u8(src), vld1q_u8(src + 1)));
+}
+
+unsigned equal_mask(const uint16_t* src)
+{
+	auto c0 = vceqq_u16(vld1q_u16(src), vld1q_u16(src + 1));
+	auto c1 = vceqq_u16(vld1q_u16(src + 8), vld1q_u16(src + 9));
+	return movemask(vcombine_u8(vmovn_u16(c0), vmovn_u16(c1)));
+}
+#endif
+
+// bit i of equal is set when src[i] == src[i + 1], for every i before
+// count - 1; the words past that are zero
+template <class T>
+void find_equal(const T* src, std::size_t count, uint64_t* equal_bits)
+{
+	std::size_t i = 0;
+#if defined(VECTOR_SCAN)
+	for (; i + 64 < count; i += 64)
+	{
+		uint64_t bits = 0;
+		for (std::size_t k = 0; k < 64; k += 16)
+		{
+			bits |= uint64_t(equal_mask(src + i + k)) << k;
+		}
+		equal_bits[i / 64] = bits;
+	}
+#endif
+	for (; i < count; i += 64)
+	{
+		uint64_t bits = 0;
+		for (std::size_t k = 0; k < 64 && i + k + 1 < count; ++k)
+		{
+			bits |= uint64_t(src[i + k] == src[i + k + 1]) << k;
+		}
+		equal_bits[i / 64] = bits;
+	}
+}
+
+// the first i in [begin, last] with bit i set in bits(word), or last + 1
+template <class Word>
+std::size_t find_bit(std::size_t begin, std::size_t last, Word word)
+{
+	for (auto i = begin; i <= last; i = (i | 63) + 1)
+	{
+		auto bits = word(i / 64) >> (i % 64);
+		if (bits)
+		{
+			auto found = i + __builtin_ctzll(bits);
+			return std::min(found, last + 1);
+		}
+	}
+
+	return last + 1;
+}
+
+// count elements, big-endian
+template <class T>
+uint8_t* store_big(uint8_t* dst, const T* src, std::size_t count)
+{
+	std::memcpy(dst, src, count * sizeof(T));
+	if constexpr (sizeof(T) > 1 && boost::endian::order::native != boost::endian::order::big)
+	{
+		AStream::byte_swap<sizeof(T)>(dst, count);
+	}
+	return dst + count * sizeof(T);
+}
+
+// short blocks are most of them in busy images; when there's room to
+// read past the block, copy a fixed 16 bytes instead of calling memcpy
+// (PackBitsBound leaves room to write past it)
+template <class T>
+uint8_t* store_literal(uint8_t* dst, const T* src, std::size_t count, std::size_t available)
+{
+	*dst++ = static_cast<uint8_t>(count - 1);
+	if (count * sizeof(T) <= 16 && available * sizeof(T) >= 16)
+	{
+		std::memcpy(dst, src, 16);
+		if constexpr (sizeof(T) > 1 && boost::endian::order::native != boost::endian::order::big)
+		{
+			AStream::byte_swap<sizeof(T)>(dst, count);
+		}
+		return dst + count * sizeof(T);
+	}
+
+	return store_big(dst, src, count);
+}
+
+template <class T>
+T load_big(const uint8_t* src)
+{
+	T value;
+	std::memcpy(&value, src, sizeof(T));
+	return boost::endian::big_to_native(value);
+}
+
+}
+
+template <class T>
+bool atque::UnpackBits(const uint8_t* src, std::size_t size, T* dst, std::size_t count, std::size_t& unpacked)
+{
+	std::size_t in = 0;
+	std::size_t out = 0;
+	while (in < size)
+	{
+		auto c = static_cast<int8_t>(src[in++]);
+
+		// -128 is a repeat of 129 rather than a no-op, as it always has
+		// been here
+		if (c < 0)
+		{
+			std::size_t run = 1 - c;
+			if (size - in < sizeof(T) || count - out < run)
+			{
+				unpacked = out;
+				return false;
+			}
+
+			fill(dst + out, load_big<T>(src + in), run);
+			in += sizeof(T);
+			out += run;
+		}
+		else
+		{
+			std::size_t run = c + 1;
+			if (size - in < run * sizeof(T) || count - out < run)
+			{
+				unpacked = out;
+				return false;
+			}
+
+			std::memcpy(dst + out, src + in, run * sizeof(T));
+			if constexpr (sizeof(T) > 1 && boost::endian::order::native != boost::endian::order::big)
+			{
+				AStream::byte_swap<sizeof(T)>(reinterpret_cast<uint8_t*>(dst + out), run);
+			}
+			in += run * sizeof(T);
+			out += run;
+		}
+	}
+
+	unpacked = out;
+	return true;
+}
+
+template bool atque::UnpackBits<uint8_t>(const uint8_t*, std::size_t, uint8_t*, std::size_t, std::size_t&);
+template bool atque::UnpackBits<uint16_t>(const uint8_t*, std::size_t, uint16_t*, std::size_t, std::size_t&);
+
+template <class T>
+std::size_t atque::PackBits(const T* src, std::size_t count, uint8_t* dst)
+{
+	if (!count)
+	{
+		return 0;
+	}
+
+	// PICT rows are at most 16K elements, so the bitmap nearly always
+	// fits on the stack
+	uint64_t stack_bits[256];
+	std::vector<uint64_t> heap_bits;
+	auto equal_bits = stack_bits;
+	auto words = (count + 63) / 64;
+	if (words > 256)
+	{
+		heap_bits.resize(words);
+		equal_bits = heap_bits.data();
+	}
+	find_equal(src, count, equal_bits);
+
+	// bit i: src[i], src[i + 1] and src[i + 2] are all equal
+	auto triples = [equal_bits, words](std::size_t word) {
+		auto next = word + 1 < words ? equal_bits[word + 1] : 0;
+		return equal_bits[word] & (equal_bits[word] >> 1 | next << 63);
+	};
+	auto unequal = [equal_bits](std::size_t word) {
+		return ~equal_bits[word];
+	};
+
+	auto out = dst;
+	std::size_t start = 0;
+	while (start < count)
+	{
+		// a repeat run has to start early enough that the literal block
+		// before it plus the first three elements of the run fit in 128
+		auto triple = count;
+		if (count - start >= 3)
+		{
+			auto last = std::min(start + 125, count - 3);
+			triple = find_bit(start, last, triples);
+			if (triple > last)
+			{
+				triple = count;
+			}
+		}
+
+		if (triple < count)
+		{
+			if (triple > start)
+			{
+				out = store_literal(out, src + start, triple - start, count - start);
+			}
+
+			// the run goes on until an element differs from the next
+			auto end = find_bit(triple + 2, std::min(count, triple + 128) - 1, unequal) + 1;
+			end = std::min(end, std::min(count, triple + 128));
+			*out++ = static_cast<uint8_t>(1 - static_cast<int>(end - triple));
+			out = store_big(out, src + triple, 1);
+			start = end;
+		}
+		else
+		{
+			auto length = std::min<std::size_t>(128, count - start);
+			out = store_literal(out, src + start, length, count - start);
+			start += length;
+		}
+	}
+
+	return out - dst;
+}
+
+template std::size_t atque::PackBits<uint8_t>(const uint8_t*, std::size_t, uint8_t*);
+template std::size_t atque::PackBits<uint16_t>(const uint16_t*, std::size_t, uint8_t*);
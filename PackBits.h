@@ -0,0 +1,59 @@
+/* PackBits.h
+
+   Copyright (C) 2026 by Gregory Smith
+   
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+   
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+   
+   This license is contained in the file "COPYING", which is included
+   with this source code; it is available online at
+   http://www.gnu.org/licenses/gpl.html
+   
+*/
+
+#ifndef PACKBITS_H
+#define PACKBITS_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace atque
+{
+
+// PackBits scan lines, as in PICT PixMaps: a control byte n, then either
+// n + 1 literal elements (n >= 0) or one element repeated 1 - n times.
+// Elements are 8- or 16-bit, big-endian in the packed data and native in
+// the unpacked row.
+
+// unpacks all size bytes of src into dst, which holds count elements;
+// false if a run reaches past either end. unpacked is the number of
+// elements written
+template <class T>
+bool UnpackBits(const uint8_t* src, std::size_t size, T* dst, std::size_t count, std::size_t& unpacked);
+
+// the most bytes PackBits can produce for count elements, plus room for
+// it to write a little past the end
+template <class T>
+constexpr std::size_t PackBitsBound(std::size_t count)
+{
+	return count * sizeof(T) + count / 128 + 1 + 16;
+}
+
+// packs count elements of src into dst, which holds at least
+// PackBitsBound<T>(count) bytes, and returns the bytes written. A literal
+// block ends at 128 elements or where three equal elements start a
+// repeat run; these are the same blocks atque has always written, so
+// merged scenarios don't change from one release to the next
+template <class T>
+std::size_t PackBits(const T* src, std::size_t count, uint8_t* dst);
+
+}
+
+#endif
@@ -0,0 +1,247 @@
+/* PixelFormats.cpp
+
+   Copyright (C) 2026 by Gregory Smith
+   
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+   
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+   
+   This license is contained in the file "COPYING", which is included
+   with this source code; it is available online at
+   http://www.gnu.org/licenses/gpl.html
+   
+*/
+
+#include "PixelFormats.h"
+
+// define ATQUE_SCALAR_PIXELS to build only the portable loops (make check
+// tests both)
+#if defined(__SSE2__) && !defined(ATQUE_SCALAR_PIXELS)
+#define PIXELS_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && !defined(ATQUE_SCALAR_PIXELS)
+#define PIXELS_NEON
+#include <arm_neon.h>
+#endif
+
+using namespace atque;
+
+namespace {
+
+// (c * 255 + 16) / 31 for 5-bit c, without the divide
+inline uint8_t expand5(unsigned c)
+{
+	return (c * 1053 + 65) >> 7;
+}
+
+#if defined(PIXELS_SSE2)
+// SSE2 has no byte shuffle, so three byte pixels go through registers of
+// four 0x00BBGGRR pixels; these close up, and open out, the gaps
+
+// four pixels to 12 bytes at the bottom of the register
+__m128i compact(__m128i pixels)
+{
+	auto lo = _mm_and_si128(pixels, _mm_set_epi32(0, 0xffffff, 0, 0xffffff));
+	auto hi = _mm_and_si128(pixels, _mm_set_epi32(0xffffff, 0, 0xffffff, 0));
+	auto halves = _mm_or_si128(lo, _mm_srli_epi64(hi, 8));
+	lo = _mm_and_si128(halves, _mm_set_epi32(0, 0, 0xffff, -1));
+	hi = _mm_and_si128(halves, _mm_set_epi32(0xffff, -1, 0, 0));
+	return _mm_or_si128(lo, _mm_srli_si128(hi, 2));
+}
+
+// 12 bytes at the bottom of the register to four pixels
+__m128i spread(__m128i bytes)
+{
+	auto lo = _mm_and_si128(bytes, _mm_set_epi32(0, 0, 0xffff, -1));
+	auto hi = _mm_and_si128(_mm_slli_si128(bytes, 2), _mm_set_epi32(0xffff, -1, 0, 0));
+	auto halves = _mm_or_si128(lo, hi);
+	lo = _mm_and_si128(halves, _mm_set_epi32(0, 0xffffff, 0, 0xffffff));
+	hi = _mm_and_si128(_mm_slli_epi64(halves, 8), _mm_set_epi32(0xffffff, 0, 0xffffff, 0));
+	return _mm_or_si128(lo, hi);
+}
+
+__m128i load(const void* src)
+{
+	return _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+}
+
+void store(void* dst, __m128i v)
+{
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), v);
+}
+
+__m128i expand5(__m128i c)
+{
+	return _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(c, _mm_set1_epi16(1053)), _mm_set1_epi16(65)), 7);
+}
+#endif
+
+}
+
+// the SSE2 loops load and store 16 bytes for every 12 they mean to, so
+// they stop while there's still that much row left
+
+void atque::ExpandRGB555(const uint16_t* src, std::size_t count, uint8_t* dst)
+{
+	std::size_t i = 0;
+#if defined(PIXELS_SSE2)
+	auto mask = _mm_set1_epi16(0x1f);
+	for (; i + 10 <= count; i += 8)
+	{
+		auto v = load(src + i);
+		auto red = expand5(_mm_and_si128(_mm_srli_epi16(v, 10), mask));
+		auto green = expand5(_mm_and_si128(_mm_srli_epi16(v, 5), mask));
+		auto blue = expand5(_mm_and_si128(v, mask));
+
+		auto red_green = _mm_or_si128(red, _mm_slli_epi16(green, 8));
+		store(dst + i * 3, compact(_mm_unpacklo_epi16(red_green, blue)));
+		store(dst + i * 3 + 12, compact(_mm_unpackhi_epi16(red_green, blue)));
+	}
+#elif defined(PIXELS_NEON)
+	auto mask = vdupq_n_u16(0x1f);
+	auto scale = vdupq_n_u16(1053);
+	auto round = vdupq_n_u16(65);
+	for (; i + 8 <= count; i += 8)
+	{
+		auto v = vld1q_u16(src + i);
+		uint8x8x3_t rgb;
+		rgb.val[0] = vshrn_n_u16(vmlaq_u16(round, vandq_u16(vshrq_n_u16(v, 10), mask), scale), 7);
+		rgb.val[1] = vshrn_n_u16(vmlaq_u16(round, vandq_u16(vshrq_n_u16(v, 5), mask), scale), 7);
+		rgb.val[2] = vshrn_n_u16(vmlaq_u16(round, vandq_u16(v, mask), scale), 7);
+		vst3_u8(dst + i * 3, rgb);
+	}
+#endif
+	for (; i < count; ++i)
+	{
+		dst[i * 3] = expand5((src[i] >> 10) & 0x1f);
+		dst[i * 3 + 1] = expand5((src[i] >> 5) & 0x1f);
+		dst[i * 3 + 2] = expand5(src[i] & 0x1f);
+	}
+}
+
+void atque::PackRGB555(const uint8_t* src, std::size_t count, uint16_t* dst)
+{
+	std::size_t i = 0;
+#if defined(PIXELS_SSE2)
+	auto mask = _mm_set1_epi32(0xf8);
+	for (; i + 10 <= count; i += 8)
+	{
+		__m128i packed[2];
+		for (int j = 0; j < 2; ++j)
+		{
+			auto pixels = spread(load(src + i * 3 + j * 12));
+			auto red = _mm_slli_epi32(_mm_and_si128(pixels, mask), 7);
+			auto green = _mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(pixels, 8), mask), 2);
+			auto blue = _mm_srli_epi32(pixels, 19);
+			packed[j] = _mm_or_si128(_mm_or_si128(red, green), blue);
+		}
+		store(dst + i, _mm_packs_epi32(packed[0], packed[1]));
+	}
+#elif defined(PIXELS_NEON)
+	for (; i + 8 <= count; i += 8)
+	{
+		auto rgb = vld3_u8(src + i * 3);
+		auto red = vshlq_n_u16(vmovl_u8(vshr_n_u8(rgb.val[0], 3)), 10);
+		auto green = vshlq_n_u16(vmovl_u8(vshr_n_u8(rgb.val[1], 3)), 5);
+		auto blue = vmovl_u8(vshr_n_u8(rgb.val[2], 3));
+		vst1q_u16(dst + i, vorrq_u16(vorrq_u16(red, green), blue));
+	}
+#endif
+	for (; i < count; ++i)
+	{
+		uint16_t red = src[i * 3] >> 3;
+		uint16_t green = src[i * 3 + 1] >> 3;
+		uint16_t blue = src[i * 3 + 2] >> 3;
+		dst[i] = (red << 10) | (green << 5) | blue;
+	}
+}
+
+void atque::InterleaveRGB(const uint8_t* src, std::size_t count, uint8_t* dst)
+{
+	const uint8_t* reds = src;
+	const uint8_t* greens = src + count;
+	const uint8_t* blues = src + count * 2;
+
+	std::size_t i = 0;
+#if defined(PIXELS_SSE2)
+	auto zero = _mm_setzero_si128();
+	for (; i + 18 <= count; i += 16)
+	{
+		auto red = load(reds + i);
+		auto green = load(greens + i);
+		auto blue = load(blues + i);
+
+		auto red_green = _mm_unpacklo_epi8(red, green);
+		auto blue_zero = _mm_unpacklo_epi8(blue, zero);
+		store(dst + i * 3, compact(_mm_unpacklo_epi16(red_green, blue_zero)));
+		store(dst + i * 3 + 12, compact(_mm_unpackhi_epi16(red_green, blue_zero)));
+
+		red_green = _mm_unpackhi_epi8(red, green);
+		blue_zero = _mm_unpackhi_epi8(blue, zero);
+		store(dst + i * 3 + 24, compact(_mm_unpacklo_epi16(red_green, blue_zero)));
+		store(dst + i * 3 + 36, compact(_mm_unpackhi_epi16(red_green, blue_zero)));
+	}
+#elif defined(PIXELS_NEON)
+	for (; i + 16 <= count; i += 16)
+	{
+		uint8x16x3_t rgb;
+		rgb.val[0] = vld1q_u8(reds + i);
+		rgb.val[1] = vld1q_u8(greens + i);
+		rgb.val[2] = vld1q_u8(blues + i);
+		vst3q_u8(dst + i * 3, rgb);
+	}
+#endif
+	for (; i < count; ++i)
+	{
+		dst[i * 3] = reds[i];
+		dst[i * 3 + 1] = greens[i];
+		dst[i * 3 + 2] = blues[i];
+	}
+}
+
+void atque::DeinterleaveRGB(const uint8_t* src, std::size_t count, uint8_t* dst)
+{
+	uint8_t* reds = dst;
+	uint8_t* greens = dst + count;
+	uint8_t* blues = dst + count * 2;
+
+	std::size_t i = 0;
+#if defined(PIXELS_SSE2)
+	auto mask = _mm_set1_epi32(0xff);
+	for (; i + 18 <= count; i += 16)
+	{
+		__m128i red[4], green[4], blue[4];
+		for (int j = 0; j < 4; ++j)
+		{
+			auto pixels = spread(load(src + i * 3 + j * 12));
+			red[j] = _mm_and_si128(pixels, mask);
+			green[j] = _mm_and_si128(_mm_srli_epi32(pixels, 8), mask);
+			blue[j] = _mm_srli_epi32(pixels, 16);
+		}
+
+		store(reds + i, _mm_packus_epi16(_mm_packs_epi32(red[0], red[1]), _mm_packs_epi32(red[2], red[3])));
+		store(greens + i, _mm_packus_epi16(_mm_packs_epi32(green[0], green[1]), _mm_packs_epi32(green[2], green[3])));
+		store(blues + i, _mm_packus_epi16(_mm_packs_epi32(blue[0], blue[1]), _mm_packs_epi32(blue[2], blue[3])));
+	}
+#elif defined(PIXELS_NEON)
+	for (; i + 16 <= count; i += 16)
+	{
+		auto rgb = vld3q_u8(src + i * 3);
+		vst1q_u8(reds + i, rgb.val[0]);
+		vst1q_u8(greens + i, rgb.val[1]);
+		vst1q_u8(blues + i, rgb.val[2]);
+	}
+#endif
+	for (; i < count; ++i)
+	{
+		reds[i] = src[i * 3];
+		greens[i] = src[i * 3 + 1];
+		blues[i] = src[i * 3 + 2];
+	}
+}
@@ -0,0 +1,47 @@
+/* PixelFormats.h
+
+   Copyright (C) 2026 by Gregory Smith
+   
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+   
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+   
+   This license is contained in the file "COPYING", which is included
+   with this source code; it is available online at
+   http://www.gnu.org/licenses/gpl.html
+   
+*/
+
+#ifndef PIXELFORMATS_H
+#define PIXELFORMATS_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace atque
+{
+
+// Conversions between the direct color rows of PICT PixMaps and the R, G,
+// B bytes PICTResource keeps its images in. Each converts count pixels
+
+// 16-bit xRRRRRGGGGGBBBBB pixels (native order) to R, G, B bytes; each
+// channel becomes (c * 255 + 16) / 31, as it always has
+void ExpandRGB555(const uint16_t* src, std::size_t count, uint8_t* dst);
+
+// R, G, B bytes to 16-bit pixels, keeping the top 5 bits of each channel
+void PackRGB555(const uint8_t* src, std::size_t count, uint16_t* dst);
+
+// a 32-bit PICT row is count reds, then count greens, then count blues;
+// these go between that and R, G, B bytes
+void InterleaveRGB(const uint8_t* src, std::size_t count, uint8_t* dst);
+void DeinterleaveRGB(const uint8_t* src, std::size_t count, uint8_t* dst);
+
+}
+
+#endif
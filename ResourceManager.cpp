@@ -20,17 +20,25 @@
 
 #include "ResourceManager.h"
 
+#include <algorithm>
+#include <cassert>
+#include <cstring>
 #include <fstream>
 #include <iostream>
-#include <set>
+#include <sstream>
 
 #include "MacBinaryII.h"
 
+#if defined(__linux__) || (defined(__APPLE__) && defined(__MACH__))
+#include <sys/xattr.h>
+#endif
+
 #include <boost/crc.hpp>
 #include <boost/endian.hpp>
 
 #include "ferro/cstypes.h"
 #include "ferro/macroman.h"
+#include "ferro/MappedFile.h"
 #include "ferro/Wadfile.h"
 
 using namespace marathon;
@@ -71,8 +79,50 @@ struct RefListEntry
 	big_uint32_t reserved;
 };
 
+ResourceManager::FileKind ResourceManager::Classify(const uint8_t* prefix, std::size_t size, std::size_t file_size)
+{
+	static_assert(classify_prefix_size == sizeof(MacBinaryII));
+	
+	if (size < classify_prefix_size)
+	{
+		return FileKind::Raw;
+	}
+
+	MacBinaryII header;
+	std::memcpy(&header, prefix, sizeof(header));
+	if (header.IsValid())
+	{
+		return FileKind::MacBinary;
+	}
+	else if (Wadfile::IsHeader(prefix, size, file_size))
+	{
+		return FileKind::Wadfile;
+	}
+	else
+	{
+		return FileKind::Raw;
+	}
+}
+
+ResourceManager::FileKind ResourceManager::Classify(const std::filesystem::path& path)
+{
+	std::error_code ec;
+	auto file_size = std::filesystem::file_size(path, ec);
+	if (ec || file_size < classify_prefix_size)
+	{
+		return FileKind::Raw;
+	}
+
+	uint8_t prefix[classify_prefix_size];
+	std::ifstream stream{path, std::ios::in | std::ios::binary};
+	stream.read(reinterpret_cast<char*>(prefix), sizeof(prefix));
+
+	return Classify(prefix, stream.gcount(), file_size);
+}
+
 bool ResourceManager::Load(const std::filesystem::path& path,
-						   read_data_cb read_data_fork)
+						   read_data_cb read_data_fork,
+						   bool load_resource_fork)
 {
 	try
 	{
@@ -86,16 +136,22 @@ bool ResourceManager::Load(const std::filesystem::path& path,
 
 		if (header.IsValid())
 		{
-			stream.seekg(header.GetResourceForkOffset());
-
-			LoadResourceFork(stream, header.resource_fork_length);
+			if (load_resource_fork &&
+				!MapResourceFork(path, header.GetResourceForkOffset(), header.resource_fork_length))
+			{
+				stream.seekg(header.GetResourceForkOffset());
+				LoadResourceFork(stream, header.resource_fork_length);
+			}
 
 			stream.seekg(header.GetDataOffset());
 			read_data_fork(stream, header.data_fork_length);
 		}
 		else
 		{
-			// TODO: check for Mac resource fork with getxattr
+			if (load_resource_fork && !LoadAttributeResourceFork(path))
+			{
+				LoadAppleDoubleResourceFork(path);
+			}
 
 			stream.seekg(0, std::ios_base::end);
 			auto length = stream.tellg();
@@ -111,8 +167,56 @@ bool ResourceManager::Load(const std::filesystem::path& path,
 	return true;
 }
 
-void ResourceManager::Save(const std::filesystem::path& path,
-						   write_data_cb write_data_fork)
+bool ResourceManager::Save(const std::filesystem::path& path,
+						   write_data_cb write_data_fork,
+						   ForkFormat format,
+						   std::streamsize data_fork_length)
+{
+	if (format == ForkFormat::MacBinary)
+	{
+		return SaveMacBinary(path, write_data_fork, data_fork_length);
+	}
+
+	{
+		std::ofstream stream{path, std::ios::out | std::ios::binary | std::ios::trunc};
+		write_data_fork(stream);
+		if (!stream)
+		{
+			return false;
+		}
+	}
+
+	if (format == ForkFormat::AppleDouble)
+	{
+		return SaveAppleDoubleResourceFork(path);
+	}
+	else
+	{
+		return SaveAttributeResourceFork(path);
+	}
+}
+
+static uint32_t FileType(const std::filesystem::path& path)
+{
+	// extension() includes the dot
+	auto extension = utf8_to_mac_roman(path.extension().u8string());
+	if (extension.size() == 5)
+	{
+		return FOUR_CHARS_TO_INT(extension[1],
+								 extension[2],
+								 extension[3],
+								 extension[4]);
+	}
+	else
+	{
+		// TODO?
+		return 0;
+	}
+}
+
+bool ResourceManager::SaveMacBinary(const std::filesystem::path& path,
+									write_data_cb write_data_fork,
+									std::streamsize data_fork_length)
 {
 	MacBinaryII header{};
 
@@ -120,53 +224,158 @@ void ResourceManager::Save(const std::filesystem::path& path,
 	header.min_macbinary_version = 129;
 	// TODO: creation date? file creator? modification date?
 	auto filename = utf8_to_mac_roman(path.stem().u8string());
-	header.filename_length = std::max(static_cast<size_t>(header.max_filename_length),
+	header.filename_length = std::min(static_cast<size_t>(header.max_filename_length),
 									  filename.size());
 	std::copy_n(filename.begin(), header.filename_length, header.filename);
 
-	auto extension = utf8_to_mac_roman(path.extension().u8string());
-	if (extension.size() == 4)
+	header.file_type = FileType(path);
+	header.resource_fork_length = ResourceForkSize();
+
+	static const char zeros[0x80] {0};
+	auto pad = [](std::ostream& stream, uint32_t length) {
+		stream.write(zeros, ((length + 0x7f) & ~0x7f) - length);
+	};
+	
+	std::ofstream stream{path, std::ios::out | std::ios::binary | std::ios::trunc};
+
+	// when the caller knows how long the data fork is, the header is
+	// complete up front and the file is written front to back
+	if (data_fork_length >= 0)
 	{
-		header.file_type = FOUR_CHARS_TO_INT(extension[0],
-											 extension[1],
-											 extension[2],
-											 extension[3]);
+		header.data_fork_length = data_fork_length;
+		header.crc = header.CalculateCRC();
+		stream.write(reinterpret_cast<char*>(&header), sizeof(MacBinaryII));
 	}
 	else
 	{
-		// TODO?
+		stream.seekp(sizeof(MacBinaryII));
 	}
-	
-	std::ofstream stream{path, std::ios::out | std::ios::binary | std::ios::trunc};
-	stream.seekp(sizeof(MacBinaryII));
 
 	write_data_fork(stream);
-	header.data_fork_length = stream.tellp() - std::streamoff{sizeof(MacBinaryII)};
-	auto padding = ((header.data_fork_length + 0x7f) & ~0x7f) - header.data_fork_length;
-	while (padding--)
+	auto written = stream.tellp() - std::streamoff{sizeof(MacBinaryII)};
+	if (data_fork_length >= 0 && written != data_fork_length)
 	{
-		stream.put('\0');
+		return false;
 	}
+	
+	header.data_fork_length = written;
+	pad(stream, header.data_fork_length);
 
 	SaveResourceFork(stream);
-	header.resource_fork_length = stream.tellp() - std::streamoff{header.GetResourceForkOffset()};
-	padding = ((header.resource_fork_length + 0x7f) & ~0x7f) - header.resource_fork_length;
-	while (padding--)
+	assert(stream.tellp() - std::streamoff{header.GetResourceForkOffset()} == header.resource_fork_length);
+	pad(stream, header.resource_fork_length);
+
+	if (data_fork_length < 0)
 	{
-		stream.put('\0');
+		header.crc = header.CalculateCRC();
+		stream.seekp(0);
+		stream.write(reinterpret_cast<char*>(&header), sizeof(MacBinaryII));
 	}
 
-	header.crc = header.CalculateCRC();
+	return static_cast<bool>(stream);
+}
 
-	stream.seekp(0);
-	stream.write(reinterpret_cast<char*>(&header), sizeof(MacBinaryII));
+std::vector<ResourceManager::ResourceInfo> ResourceManager::List() const
+{
+	Sort();
+
+	std::vector<ResourceInfo> list;
+	list.reserve(resources_.size());
+	for (const auto& resource : resources_)
+	{
+		ResourceInfo info;
+		info.id = std::make_pair(resource.type(), resource.id());
+		info.size = resource.data.size();
+		info.name = resource.name;
+		list.push_back(std::move(info));
+	}
+
+	return list;
+}
+
+static ResourceManager::const_iterator LowerBound(ResourceManager::const_iterator first, ResourceManager::const_iterator last, uint64_t key)
+{
+	return std::lower_bound(first, last, key, [](const ResourceManager::Resource& resource, uint64_t key) {
+			return resource.key < key;
+		});
+}
+
+std::pair<ResourceManager::const_iterator, ResourceManager::const_iterator> ResourceManager::Range(uint32_t type) const
+{
+	Sort();
+
+	auto first = LowerBound(resources_.cbegin(), resources_.cend(), uint64_t{type} << 16);
+	auto last = LowerBound(first, resources_.cend(), (uint64_t{type} + 1) << 16);
+
+	return std::make_pair(first, last);
+}
+
+const ResourceManager::Resource* ResourceManager::Find(res_id_t id) const
+{
+	Sort();
+
+	auto key = MakeKey(id);
+	auto it = LowerBound(resources_.cbegin(), resources_.cend(), key);
+
+	if (it != resources_.cend() && it->key == key)
+	{
+		return &*it;
+	}
+	else
+	{
+		return nullptr;
+	}
+}
+
+void ResourceManager::Add(res_id_t id, const res_data_t& data, const std::string& name)
+{
+	resources_.emplace_back(id, data, name);
+	fork_data_length_ += sizeof(uint32_t) + data.size();
+	if (resources_.size() > 1 && resources_[resources_.size() - 2].key >= resources_.back().key)
+	{
+		sorted_ = false;
+	}
+}
+
+void ResourceManager::Sort() const
+{
+	if (sorted_)
+	{
+		return;
+	}
+
+	std::stable_sort(resources_.begin(), resources_.end(), [](const Resource& a, const Resource& b) {
+			return a.key < b.key;
+		});
+
+	// of several resources with the same id, the last one added wins
+	auto out = resources_.begin();
+	for (auto it = resources_.begin(); it != resources_.end(); ++it)
+	{
+		auto next = std::next(it);
+		if (next == resources_.end() || next->key != it->key)
+		{
+			if (out != it)
+			{
+				*out = std::move(*it);
+			}
+			++out;
+		}
+		else
+		{
+			fork_data_length_ -= sizeof(uint32_t) + it->data.size();
+		}
+	}
+	resources_.erase(out, resources_.end());
+	
+	sorted_ = true;
 }
 
 bool ResourceManager::CanSaveToWadfile(Wadfile& wadfile)
 {
-	for (const auto& [key, data] : resource_map_)
+	for (const auto& resource : resources())
 	{
-		const auto& [res_type, res_id] = key;
+		auto res_id = resource.id();
 		if (wadfile.HasWad(res_id) &&
 			wadfile.GetWad(res_id).HasChunk(MapInfo::kTag))
 		{
@@ -177,184 +386,494 @@ bool ResourceManager::CanSaveToWadfile(Wadfile& wadfile)
 	return true;
 }
 
-bool ResourceManager::CanSaveToResourceFork()
+ResourceManager::ForkLayout ResourceManager::PlanForkLayout(Wadfile& wadfile) const
 {
-	int size = 0;
-	for (const auto& [key, value] : resource_map_)
+	ForkLayout layout;
+	layout.fork_data_length = fork_data_length();
+
+	std::vector<const Resource*> candidates;
+	for (auto type : { FOUR_CHARS_TO_INT('s','n','d',' '), FOUR_CHARS_TO_INT('P','I','C','T') })
 	{
-		size += value.size();
-		if (size >= max_resource_fork_data_size)
+		auto [first, last] = Range(type);
+		for (auto it = first; it != last; ++it)
 		{
-			return false;
+			auto res_id = it->id();
+			if (!wadfile.HasWad(res_id) ||
+				!wadfile.GetWad(res_id).HasChunk(MapInfo::kTag))
+			{
+				candidates.push_back(&*it);
+			}
 		}
 	}
 
-	return true;
+	std::stable_sort(candidates.begin(), candidates.end(), [](const Resource* a, const Resource* b) {
+			return a->data.size() > b->data.size();
+		});
+
+	for (auto it = candidates.begin(); it != candidates.end() && layout.fork_data_length > max_resource_fork_data_size; ++it)
+	{
+		const auto& resource = **it;
+		auto length = sizeof(uint32_t) + resource.data.size();
+		layout.wadfile_resources.push_back(std::make_pair(resource.type(), resource.id()));
+		layout.wadfile_data_length += length;
+		layout.fork_data_length -= length;
+	}
+
+	layout.fits = layout.fork_data_length <= max_resource_fork_data_size;
+	return layout;
 }
 
 void ResourceManager::LoadFromWadfile(Wadfile& wadfile)
 {
+	// resources already loaded (from the resource fork) take precedence
+	Sort();
+	auto loaded = resources_.size();
+	auto is_loaded = [this, loaded](res_id_t id) {
+		auto last = resources_.cbegin() + loaded;
+		auto it = LowerBound(resources_.cbegin(), last, MakeKey(id));
+		return it != last && it->key == MakeKey(id);
+	};
+	
 	// assume any chunks without MapInfo tags are resources
 	for (const auto& index : wadfile.GetWadIndexes())
 	{
-		auto wad = wadfile.GetWad(index);
+		// a damaged wad holds no resources we can use; leave it to the
+		// level code to report
+		const Wad* parsed;
+		try
+		{
+			parsed = &wadfile.GetWad(index);
+		}
+		catch (const std::exception&)
+		{
+			continue;
+		}
+
+		const auto& wad = *parsed;
 		auto name = wadfile.GetLevelName(index);
 		if (!wad.HasChunk(MapInfo::kTag))
 		{
 			for (const auto& tag : wad.GetTags())
 			{
-				auto data = wad.GetChunk(tag);
 				auto id = std::make_pair(tag, index);
-				resource_map_.insert(std::make_pair(id, std::move(data)));
-
-				if (!name.empty())
+				if (!is_loaded(id))
 				{
-					name_map_.insert(std::make_pair(id, name));
+					Add(id, wad.GetSharedChunk(tag), name);
 				}
 			}
 		}
 	}
 }
 
+void ResourceManager::SaveToWadfile(Wadfile& wadfile, const Resource& resource)
+{
+	auto res_type = resource.type();
+	auto res_id = resource.id();
+
+	// Win95 resource conversions
+	if (res_type == FOUR_CHARS_TO_INT('T','E','X','T'))
+	{
+		res_type = FOUR_CHARS_TO_INT('t','e','x','t');
+	}
+		
+	Wad wad;
+	if (wadfile.HasWad(res_id))
+	{
+		wad = wadfile.GetWad(res_id);
+	}
+
+	if (!wad.HasChunk(MapInfo::kTag))
+	{
+		wad.AddChunk(res_type, resource.data);
+		wadfile.SetWad(res_id, std::move(wad));
+	}
+}
+
 void ResourceManager::SaveToWadfile(Wadfile& wadfile)
 {
-	for (const auto& [key, data] : resource_map_)
+	for (const auto& resource : resources())
 	{
-		auto [res_type, res_id] = key;
+		SaveToWadfile(wadfile, resource);
+	}
+}
 
-		// Win95 resource conversions
-		if (res_type == FOUR_CHARS_TO_INT('T','E','X','T'))
+void ResourceManager::SaveToWadfile(Wadfile& wadfile, const ForkLayout& layout)
+{
+	std::vector<uint64_t> keys;
+	for (const auto& id : layout.wadfile_resources)
+	{
+		keys.push_back(MakeKey(id));
+	}
+	std::sort(keys.begin(), keys.end());
+
+	Sort();
+	auto out = resources_.begin();
+	for (auto it = resources_.begin(); it != resources_.end(); ++it)
+	{
+		if (std::binary_search(keys.begin(), keys.end(), it->key))
 		{
-			res_type = FOUR_CHARS_TO_INT('t','e','x','t');
+			SaveToWadfile(wadfile, *it);
+			fork_data_length_ -= sizeof(uint32_t) + it->data.size();
 		}
-		
-		Wad wad;
-		if (wadfile.HasWad(res_id))
+		else
 		{
-			wad = wadfile.GetWad(res_id);
+			if (out != it)
+			{
+				*out = std::move(*it);
+			}
+			++out;
 		}
+	}
+	resources_.erase(out, resources_.end());
+}
 
-		if (!wad.HasChunk(MapInfo::kTag))
+void ResourceManager::LoadResourceFork(std::istream& stream, std::streamsize length)
+{
+	// one read for the whole fork; resources are slices of it
+	std::vector<uint8_t> fork(length);
+	stream.read(reinterpret_cast<char*>(fork.data()), fork.size());
+	LoadResourceFork(SharedBuffer(std::move(fork)));
+}
+
+// resources become slices of the mapping, so their pages are only read
+// when something looks at them; false if the file can't be mapped
+bool ResourceManager::MapResourceFork(const std::filesystem::path& path, std::size_t offset, std::size_t length)
+{
+	std::shared_ptr<MappedFile> file;
+	try
+	{
+		file = std::make_shared<MappedFile>(path);
+	}
+	catch (const std::ios_base::failure&)
+	{
+		return false;
+	}
+
+	if (offset > file->size() || file->size() - offset < length)
+	{
+		throw std::ios_base::failure("resource fork is truncated");
+	}
+
+	LoadResourceFork(SharedBuffer(file, file->data() + offset, length));
+	return true;
+}
+
+struct AppleDoubleHeader
+{
+	static constexpr uint32_t kMagic = 0x00051607;
+	static constexpr uint32_t kVersion = 0x00020000;
+	
+	big_uint32_t magic;
+	big_uint32_t version;
+	char filler[16];
+	big_uint16_t num_entries;
+};
+
+struct AppleDoubleEntry
+{
+	static constexpr uint32_t kResourceFork = 2;
+	static constexpr uint32_t kFinderInfo = 9;
+	
+	big_uint32_t id;
+	big_uint32_t offset;
+	big_uint32_t length;
+};
+
+static_assert(sizeof(AppleDoubleHeader) == 26);
+static_assert(sizeof(AppleDoubleEntry) == 12);
+
+std::filesystem::path ResourceManager::AppleDoublePath(const std::filesystem::path& path)
+{
+	return path.parent_path() / ("._" + path.filename().string());
+}
+
+bool ResourceManager::LoadAppleDoubleResourceFork(const std::filesystem::path& path)
+{
+	auto apple_double_path = AppleDoublePath(path);
+	
+	std::ifstream stream{apple_double_path, std::ios::in | std::ios::binary};
+	if (!stream)
+	{
+		return false;
+	}
+
+	stream.exceptions(std::ifstream::eofbit |
+					  std::ifstream::failbit |
+					  std::ifstream::badbit);
+
+	// ._ files turn up wherever Macs have written to a foreign volume,
+	// and aren't always whole; a bad one is no resource fork at all,
+	// rather than a reason to give up on the data fork
+	auto loaded = resources_.size();
+	auto sorted = sorted_;
+	auto fork_data_length = fork_data_length_;
+	try
+	{
+		AppleDoubleHeader header;
+		stream.read(reinterpret_cast<char*>(&header), sizeof(header));
+		if (header.magic != AppleDoubleHeader::kMagic ||
+			header.version != AppleDoubleHeader::kVersion)
 		{
-			wad.AddChunk(res_type, data);
-			wadfile.SetWad(res_id, wad);
+			return false;
+		}
+
+		for (auto i = 0; i < header.num_entries; ++i)
+		{
+			AppleDoubleEntry entry;
+			stream.read(reinterpret_cast<char*>(&entry), sizeof(entry));
+			if (entry.id == AppleDoubleEntry::kResourceFork)
+			{
+				if (entry.length == 0)
+				{
+					return false;
+				}
+				
+				if (!MapResourceFork(apple_double_path, entry.offset, entry.length))
+				{
+					stream.seekg(std::streamoff{entry.offset});
+					LoadResourceFork(stream, entry.length);
+				}
+				
+				return true;
+			}
 		}
 	}
+	catch (const std::ios_base::failure&)
+	{
+		// drop whatever made it in before the fork ran out
+		resources_.erase(resources_.begin() + loaded, resources_.end());
+		sorted_ = sorted;
+		fork_data_length_ = fork_data_length;
+	}
+
+	return false;
 }
 
-void ResourceManager::LoadResourceFork(std::istream& stream, std::streamsize)
+bool ResourceManager::SaveAppleDoubleResourceFork(const std::filesystem::path& path)
 {
-	std::streampos fork_start = stream.tellg();
+	std::ofstream stream{AppleDoublePath(path), std::ios::out | std::ios::binary | std::ios::trunc};
+
+	AppleDoubleHeader header{};
+	header.magic = AppleDoubleHeader::kMagic;
+	header.version = AppleDoubleHeader::kVersion;
+	header.num_entries = 2;
+
+	// the Finder info only carries the file type
+	uint8_t finder_info[32] {0};
+	big_uint32_t file_type = FileType(path);
+	std::memcpy(finder_info, &file_type, sizeof(file_type));
+
+	AppleDoubleEntry entries[2] {};
+	entries[0].id = AppleDoubleEntry::kFinderInfo;
+	entries[0].offset = sizeof(header) + sizeof(entries);
+	entries[0].length = sizeof(finder_info);
+	entries[1].id = AppleDoubleEntry::kResourceFork;
+	entries[1].offset = entries[0].offset + entries[0].length;
+
+	stream.seekp(std::streamoff{entries[1].offset});
+	SaveResourceFork(stream);
+	entries[1].length = stream.tellp() - std::streamoff{entries[1].offset};
 
-	ResourceHeader header;
-	stream.read(reinterpret_cast<char*>(&header), sizeof(ResourceHeader));
-	std::streampos map_start = fork_start + static_cast<std::streamoff>(header.map_offset);
-	stream.seekg(map_start);
+	stream.seekp(0);
+	stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	stream.write(reinterpret_cast<const char*>(entries), sizeof(entries));
+	stream.write(reinterpret_cast<const char*>(finder_info), sizeof(finder_info));
 
-	ResourceMap map;
-	stream.read(reinterpret_cast<char*>(&map), sizeof(ResourceMap));
-	stream.seekg(map_start + static_cast<std::streamoff>(map.type_list_offset + 2));
+	return static_cast<bool>(stream);
+}
 
-	std::vector<TypeListEntry> type_list;
-	for (auto i = 0; i <= map.num_types; ++i)
+#if defined(__linux__)
+// Linux only lets users set attributes in the user namespace
+static const char* const kResourceForkAttribute = "user.com.apple.ResourceFork";
+
+static ssize_t GetAttribute(const std::filesystem::path& path, void* value, size_t size)
+{
+	return getxattr(path.c_str(), kResourceForkAttribute, value, size);
+}
+
+static int SetAttribute(const std::filesystem::path& path, const void* value, size_t size)
+{
+	return setxattr(path.c_str(), kResourceForkAttribute, value, size, 0);
+}
+#elif defined(__APPLE__) && defined(__MACH__)
+static const char* const kResourceForkAttribute = XATTR_RESOURCEFORK_NAME;
+
+static ssize_t GetAttribute(const std::filesystem::path& path, void* value, size_t size)
+{
+	return getxattr(path.c_str(), kResourceForkAttribute, value, size, 0, 0);
+}
+
+static int SetAttribute(const std::filesystem::path& path, const void* value, size_t size)
+{
+	return setxattr(path.c_str(), kResourceForkAttribute, value, size, 0, 0);
+}
+#else
+static long GetAttribute(const std::filesystem::path&, void*, size_t) { return -1; }
+static int SetAttribute(const std::filesystem::path&, const void*, size_t) { return -1; }
+#endif
+
+bool ResourceManager::LoadAttributeResourceFork(const std::filesystem::path& path)
+{
+	auto size = GetAttribute(path, nullptr, 0);
+	if (size <= 0)
 	{
-		TypeListEntry entry;
-		stream.read(reinterpret_cast<char*>(&entry), sizeof(TypeListEntry));
-		type_list.push_back(entry);
+		return false;
+	}
 
+	std::vector<uint8_t> fork(size);
+	size = GetAttribute(path, fork.data(), fork.size());
+	if (size <= 0)
+	{
+		return false;
 	}
 
-	std::vector<RefListEntry> ref_list;
-	for (const auto& tl_entry : type_list)
+	fork.resize(size);
+	LoadResourceFork(SharedBuffer(std::move(fork)));
+	return true;
+}
+
+bool ResourceManager::SaveAttributeResourceFork(const std::filesystem::path& path)
+{
+	std::ostringstream stream;
+	SaveResourceFork(stream);
+
+	auto fork = stream.str();
+	return SetAttribute(path, fork.data(), fork.size()) == 0;
+}
+
+// copies a big endian struct out of the fork, or throws if it runs off
+// the end
+template <typename T>
+static T ReadStruct(const SharedBuffer& fork, std::size_t offset)
+{
+	if (offset > fork.size() || fork.size() - offset < sizeof(T))
 	{
-		for (auto i = 0; i <= tl_entry.num_refs; ++i)
-		{
-			RefListEntry rl_entry;
-			stream.read(reinterpret_cast<char*>(&rl_entry), sizeof(RefListEntry));
-			ref_list.push_back(rl_entry);
-		}
+		throw std::ios_base::failure("resource fork is truncated");
 	}
 
-	auto it = ref_list.begin();
-	for (const auto& tl_entry : type_list)
+	T t;
+	std::memcpy(&t, fork.data() + offset, sizeof(T));
+	return t;
+}
+
+void ResourceManager::LoadResourceFork(const SharedBuffer& fork)
+{
+	auto header = ReadStruct<ResourceHeader>(fork, 0);
+	std::size_t map_start = header.map_offset;
+	auto map = ReadStruct<ResourceMap>(fork, map_start);
+
+	std::size_t type_list_start = map_start + map.type_list_offset;
+	std::size_t name_list_start = map_start + map.name_list_offset;
+	
+	for (auto i = 0; i <= map.num_types; ++i)
 	{
-		for (auto i = 0; i <= tl_entry.num_refs; ++i)
-		{
-			auto& rl_entry = *it++;
+		auto tl_entry = ReadStruct<TypeListEntry>(fork, type_list_start + 2 + i * sizeof(TypeListEntry));
+		std::size_t ref_list_start = type_list_start + tl_entry.ref_list_offset;
 
-			stream.seekg(fork_start + std::streamoff{header.data_offset} +
-						 std::streamoff{rl_entry.data_offset & 0x00FFFFFF});
-			big_uint32_t data_length;
-			stream.read(reinterpret_cast<char*>(&data_length), sizeof(big_uint32_t));
+		for (auto j = 0; j <= tl_entry.num_refs; ++j)
+		{
+			auto rl_entry = ReadStruct<RefListEntry>(fork, ref_list_start + j * sizeof(RefListEntry));
 
-			std::vector<uint8_t> data(data_length);
-			stream.read(reinterpret_cast<char*>(data.data()), data.size());
+			std::size_t data_start = std::size_t{header.data_offset} + (rl_entry.data_offset & 0x00FFFFFF);
+			uint32_t data_length = ReadStruct<big_uint32_t>(fork, data_start);
+			data_start += sizeof(big_uint32_t);
+			if (data_length > fork.size() - data_start)
+			{
+				throw std::ios_base::failure("resource fork is truncated");
+			}
 
-			auto id = std::make_pair(tl_entry.type, rl_entry.id);
-			resource_map_.insert(std::make_pair(id, std::move(data)));
-			
+			auto id = std::make_pair(uint32_t{tl_entry.type}, int16_t{rl_entry.id});
+			std::string name;
 			if (rl_entry.name_list_offset != -1)
 			{
-				stream.seekg(map_start + std::streamoff{map.name_list_offset} + std::streamoff{rl_entry.name_list_offset});
-				unsigned char length = stream.get();
-				char buf[256] {0};
-				stream.read(buf, length);
+				std::size_t name_start = name_list_start + rl_entry.name_list_offset;
+				uint8_t length = ReadStruct<uint8_t>(fork, name_start);
+				if (length > fork.size() - name_start - 1)
+				{
+					throw std::ios_base::failure("resource fork is truncated");
+				}
 
-				name_map_.insert(std::make_pair(id, std::string{buf, length}));
+				name.assign(reinterpret_cast<const char*>(fork.data() + name_start + 1), length);
 			}
+
+			Add(id, SharedBuffer(fork, data_start, data_length), name);
 		}
 	}
 }
  
+std::size_t ResourceManager::ResourceForkSize() const
+{
+	std::size_t size = sizeof(ResourceHeader) + sizeof(ResourceMap);
+	uint32_t type = 0;
+	for (const auto& resource : resources())
+	{
+		if (&resource == &resources_.front() || resource.type() != type)
+		{
+			type = resource.type();
+			size += sizeof(TypeListEntry);
+		}
+
+		size += sizeof(RefListEntry);
+		if (!resource.name.empty())
+		{
+			size += 1 + std::min(resource.name.size(), 255UL);
+		}
+
+		size += sizeof(uint32_t) + resource.data.size();
+	}
+
+	return size;
+}
+
 void ResourceManager::SaveResourceFork(std::ostream& stream)
 {
 	auto fork_start = stream.tellp();
 
-	// re-order the resource map for output
-	std::map<uint32_t, std::set<int16_t>> res_set;
-	for (auto& [key, value] : resource_map_)
-	{
-		auto& [res_type, res_id] = key;
-		res_set[res_type].insert(res_id);
-	}
+	const auto& resources = this->resources();
 
-	int16_t ref_list_offset = res_set.size() * sizeof(TypeListEntry) + 2;
+	// resources are already in output order, so one pass lays out the
+	// type and reference lists
 	int16_t name_list_offset = 0;
 	int32_t data_offset = 0;
 	
 	std::vector<TypeListEntry> type_list;
 	std::vector<RefListEntry> ref_list;
-	for (auto& [res_type, set] : res_set)
+	ref_list.reserve(resources.size());
+	for (const auto& resource : resources)
 	{
-		TypeListEntry type_list_entry{};
-		type_list_entry.type = res_type;
-		type_list_entry.num_refs = static_cast<int16_t>(set.size() - 1);
-		type_list_entry.ref_list_offset = ref_list_offset;
+		if (type_list.empty() || type_list.back().type != resource.type())
+		{
+			TypeListEntry type_list_entry{};
+			type_list_entry.type = resource.type();
+			type_list_entry.num_refs = -1;
+			type_list_entry.ref_list_offset = ref_list.size() * sizeof(RefListEntry);
+			type_list.push_back(type_list_entry);
+		}
+		type_list.back().num_refs = type_list.back().num_refs + 1;
 
-		type_list.push_back(type_list_entry);
-		
-		for (auto& res_id : set)
+		RefListEntry ref_list_entry{};
+		ref_list_entry.id = resource.id();
+		if (!resource.name.empty())
 		{
-			RefListEntry ref_list_entry{};
-			ref_list_entry.id = res_id;
-			auto name_it = name_map_.find(std::make_pair(res_type, res_id));
-			if (name_it != name_map_.end())
-			{
-				ref_list_entry.name_list_offset = name_list_offset;
-				name_list_offset += 1 + std::min(name_it->second.size(), 255UL);
-			}
-			else
-			{
-				ref_list_entry.name_list_offset = -1;
-			}
+			ref_list_entry.name_list_offset = name_list_offset;
+			name_list_offset += 1 + std::min(resource.name.size(), 255UL);
+		}
+		else
+		{
+			ref_list_entry.name_list_offset = -1;
+		}
 
-			ref_list_entry.data_offset = data_offset;
-			data_offset += sizeof(uint32_t);
-			data_offset += resource_map_[std::make_pair(res_type, res_id)].size();
+		ref_list_entry.data_offset = data_offset;
+		data_offset += sizeof(uint32_t);
+		data_offset += resource.data.size();
 
-			ref_list.push_back(ref_list_entry);
-			ref_list_offset += sizeof(RefListEntry);
-		}
+		ref_list.push_back(ref_list_entry);
+	}
+
+	// reference list offsets are from the start of the type list
+	for (auto& type_list_entry : type_list)
+	{
+		type_list_entry.ref_list_offset = type_list_entry.ref_list_offset + type_list.size() * sizeof(TypeListEntry) + 2;
 	}
 
 	ResourceHeader header{};
@@ -380,49 +899,32 @@ void ResourceManager::SaveResourceFork(std::ostream& stream)
 	map.num_types = type_list.size() - 1;
 
 	stream.write(reinterpret_cast<char*>(&map), sizeof(ResourceMap));
-
-	for (const auto& type_list_entry : type_list)
-	{
-		stream.write(reinterpret_cast<const char*>(&type_list_entry),
-					 sizeof(TypeListEntry));
-	}
-
-	for (const auto& ref_list_entry : ref_list)
-	{
-		stream.write(reinterpret_cast<const char*>(&ref_list_entry),
-					 sizeof(RefListEntry));
-	}
+	stream.write(reinterpret_cast<const char*>(type_list.data()),
+				 type_list.size() * sizeof(TypeListEntry));
+	stream.write(reinterpret_cast<const char*>(ref_list.data()),
+				 ref_list.size() * sizeof(RefListEntry));
 
 	assert(stream.tellp() - map_start == map.name_list_offset);
 
-	for (auto& [res_type, set] : res_set)
+	for (const auto& resource : resources)
 	{
-		for (auto& res_id : set)
+		if (!resource.name.empty())
 		{
-			auto name_it = name_map_.find(std::make_pair(res_type, res_id));
-			if (name_it != name_map_.end())
-			{
-				auto& name = name_it->second;
-				uint8_t length = std::min(name.size(), 255UL);
-				stream.put(length);
-				stream.write(name.data(), length);
-			}
+			uint8_t length = std::min(resource.name.size(), 255UL);
+			stream.put(length);
+			stream.write(resource.name.data(), length);
 		}
 	}
 
 	assert(stream.tellp() - fork_start == header.data_offset);
 
-	for (auto& [res_type, set] : res_set)
+	for (const auto& resource : resources)
 	{
-		for (auto& res_id : set)
-		{
-			auto& data = resource_map_[std::make_pair(res_type, res_id)];
-			big_uint32_t data_length = data.size();
+		big_uint32_t data_length = resource.data.size();
 
-			stream.write(reinterpret_cast<char*>(&data_length),
-						 sizeof(data_length));
-			stream.write(reinterpret_cast<char*>(data.data()), data.size());
-		}
+		stream.write(reinterpret_cast<char*>(&data_length),
+					 sizeof(data_length));
+		stream.write(reinterpret_cast<const char*>(resource.data.data()), resource.data.size());
 	}
 
 	assert(stream.tellp() - fork_start == header.data_offset + header.data_length);
@@ -24,8 +24,10 @@
 #include <cstdint>
 #include <filesystem>
 #include <functional>
-#include <map>
 #include <string>
+#include <vector>
+
+#include "ferro/SharedBuffer.h"
 
 namespace marathon
 {
@@ -34,40 +36,133 @@ class Wadfile;
 class ResourceManager
 {
 public:
-	static constexpr auto max_resource_fork_data_size = 2U << 24;
+	// resource data offsets are 24 bits
+	static constexpr auto max_resource_fork_data_size = 1U << 24;
+
+	// where Save puts the resource fork: wrapped with the data fork in
+	// a MacBinary II file, in an AppleDouble "._name" file next to the
+	// data fork, or in the data fork's resource fork extended attribute
+	enum class ForkFormat { MacBinary, AppleDouble, ExtendedAttribute };
+	
+	// what the first classify_prefix_size bytes of a file say it is; a
+	// MacBinary file may well hold a wadfile
+	enum class FileKind { MacBinary, Wadfile, Raw };
+	static constexpr std::size_t classify_prefix_size = 128;
+
+	// file_size, if known, lets wadfile detection check the directory
+	static FileKind Classify(const uint8_t* prefix, std::size_t size, std::size_t file_size = 0);
+
+	// reads just the prefix, with no stream exceptions; Raw if the file
+	// can't be read
+	static FileKind Classify(const std::filesystem::path& path);
 	
 	using res_id_t = std::pair<uint32_t, int16_t>;
-	using res_data_t = std::vector<uint8_t>;
-	using res_map_t = std::map<res_id_t, res_data_t>;
-	using name_map_t = std::map<res_id_t, std::string>;
+	using res_data_t = SharedBuffer;
 
 	using read_data_cb = std::function<void(std::istream& stream,
 											std::streamsize length)>;
 	using write_data_cb = std::function<void(std::ostream& stream)>;
 
-	const res_map_t& resource_map() const { return resource_map_; }
-	res_map_t& resource_map() { return resource_map_; }
+	struct ResourceInfo
+	{
+		res_id_t id;
+		std::size_t size;
+		std::string name;
+	};
+
+	struct Resource
+	{
+		Resource(res_id_t id, const res_data_t& data, const std::string& name) : key(MakeKey(id)), data(data), name(name) { }
+
+		uint32_t type() const { return static_cast<uint32_t>(key >> 16); }
+		int16_t id() const { return static_cast<int16_t>((key & 0xffff) ^ 0x8000); }
+
+		// type in the high 32 bits, then the id with its sign bit
+		// flipped, so keys sort the same way (type, id) pairs do
+		uint64_t key;
+		res_data_t data;
+		std::string name;
+	};
+
+	using const_iterator = std::vector<Resource>::const_iterator;
+
+	// sorted by type, then id
+	const std::vector<Resource>& resources() const { Sort(); return resources_; }
+	bool empty() const { return resources_.empty(); }
+
+	// the resources of one type
+	std::pair<const_iterator, const_iterator> Range(uint32_t type) const;
 
-	const name_map_t& name_map() const { return name_map_; }
-	name_map_t& name_map() { return name_map_; }
+	// nullptr if there is no such resource
+	const Resource* Find(res_id_t id) const;
 
-	bool Load(const std::filesystem::path& path, read_data_cb read_data_fork);
-	void Save(const std::filesystem::path& path, write_data_cb write_data_fork);
+	// replaces any resource with the same id
+	void Add(res_id_t id, const res_data_t& data, const std::string& name = std::string());
+
+	// types, ids, sizes and names; doesn't touch the resource data
+	std::vector<ResourceInfo> List() const;
+
+	// without load_resource_fork, only the data fork is read; files that
+	// aren't MacBinary get their resource fork from the extended
+	// attribute or an AppleDouble file, if there is one
+	bool Load(const std::filesystem::path& path, read_data_cb read_data_fork, bool load_resource_fork = true);
+
+	// if data_fork_length is given, write_data_fork must write exactly
+	// that much, and MacBinary files are written without seeking back
+	bool Save(const std::filesystem::path& path, write_data_cb write_data_fork, ForkFormat format = ForkFormat::MacBinary, std::streamsize data_fork_length = -1);
+
+	static std::filesystem::path AppleDoublePath(const std::filesystem::path& path);
 
 	bool CanSaveToWadfile(Wadfile& wadfile);
-	bool CanSaveToResourceFork();
+	bool CanSaveToResourceFork() const { return fork_data_length() <= max_resource_fork_data_size; }
+
+	// length of the fork's data area: each resource plus its length
+	std::size_t fork_data_length() const { Sort(); return fork_data_length_; }
+
+	// which resources to move to the wadfile so the rest fit in the fork
+	struct ForkLayout
+	{
+		std::vector<res_id_t> wadfile_resources;
+		std::size_t wadfile_data_length = 0;
+		std::size_t fork_data_length = 0;
+		bool fits = false;
+	};
+
+	// picks the largest snd and PICT resources whose ids aren't levels
+	// until the rest fit; fits is false if even that isn't enough
+	ForkLayout PlanForkLayout(Wadfile& wadfile) const;
 
 	// win95 resources are stored as chunks in levels in the wadfile
 	void LoadFromWadfile(Wadfile& wadfile);
 	void SaveToWadfile(Wadfile& wadfile);
 
+	// moves just the layout's wadfile resources into the wadfile
+	void SaveToWadfile(Wadfile& wadfile, const ForkLayout& layout);
+
 private:
 	bool LoadResourceMap(std::istream& stream, std::streamsize length);
 	void LoadResourceFork(std::istream& stream, std::streamsize length);
+	void LoadResourceFork(const SharedBuffer& fork);
+	bool MapResourceFork(const std::filesystem::path& path, std::size_t offset, std::size_t length);
+	bool LoadAppleDoubleResourceFork(const std::filesystem::path& path);
+	bool LoadAttributeResourceFork(const std::filesystem::path& path);
 	void SaveResourceFork(std::ostream& stream);
+	bool SaveMacBinary(const std::filesystem::path& path, write_data_cb write_data_fork, std::streamsize data_fork_length);
+	std::size_t ResourceForkSize() const;
+	bool SaveAppleDoubleResourceFork(const std::filesystem::path& path);
+	bool SaveAttributeResourceFork(const std::filesystem::path& path);
+	static void SaveToWadfile(Wadfile& wadfile, const Resource& resource);
+
+	static uint64_t MakeKey(res_id_t id) {
+		return (uint64_t{id.first} << 16) | (static_cast<uint16_t>(id.second) ^ 0x8000);
+	}
+
+	// Add just appends; the first lookup afterwards sorts
+	void Sort() const;
 	
-	res_map_t resource_map_;
-	name_map_t name_map_;
+	mutable std::vector<Resource> resources_;
+	mutable bool sorted_ = true;
+	mutable std::size_t fork_data_length_ = 0;
 };
 
 }
@@ -0,0 +1,289 @@
+/* Stats.cpp
+
+   Copyright (C) 2026 by Gregory Smith
+   
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+   
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+   
+   This license is contained in the file "COPYING", which is included
+   with this source code; it is available online at
+   http://www.gnu.org/licenses/gpl.html
+   
+*/
+
+#include "Stats.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+using namespace atque;
+namespace fs = std::filesystem;
+
+std::atomic<bool> atque::detail::count_allocations{false};
+thread_local std::uint64_t atque::detail::allocation_count = 0;
+
+namespace {
+
+const char* phase_names[Stats::kPhaseCount] = {
+	"load",
+	"map_info",
+	"physics",
+	"shapes",
+	"sounds",
+	"terminal",
+	"scripts",
+	"level",
+	"link",
+	"PICT",
+	"snd",
+	"clut",
+	"TEXT",
+	"term",
+	"resource",
+	"write"
+};
+
+// four characters when they're printable, hex otherwise, same as the
+// export folder names
+std::string type_name(uint32_t type)
+{
+	std::string name;
+	for (auto shift = 24; shift >= 0; shift -= 8)
+	{
+		name += static_cast<char>(type >> shift);
+	}
+
+	if (std::any_of(name.begin(), name.end(), [](char c) { return c < 0x20 || c > 0x7e || c == '"' || c == '\\' || c == ','; }))
+	{
+		std::ostringstream oss;
+		oss << std::hex << std::setw(8) << std::setfill('0') << type;
+		name = oss.str();
+	}
+
+	return name;
+}
+
+double seconds(std::uint64_t nanoseconds)
+{
+	return nanoseconds / 1e9;
+}
+
+}
+
+const char* Stats::PhaseName(Phase phase)
+{
+	return phase_names[phase];
+}
+
+std::uint64_t Stats::Allocations()
+{
+	return detail::allocation_count;
+}
+
+void Stats::CountAllocations()
+{
+	detail::count_allocations = true;
+}
+
+Stats::Timer::Timer(Stats* stats, Phase phase) :
+	stats_(stats),
+	phase_(phase)
+{
+	if (stats_)
+	{
+		allocations_ = Allocations();
+		start_ = std::chrono::steady_clock::now();
+	}
+}
+
+Stats::Timer::~Timer()
+{
+	if (stats_)
+	{
+		auto elapsed = std::chrono::steady_clock::now() - start_;
+		stats_->Record(*this, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count(), Allocations() - allocations_);
+	}
+}
+
+void Stats::Timer::file_read(const fs::path& path)
+{
+	std::error_code ec;
+	if (stats_)
+	{
+		auto size = fs::file_size(path, ec);
+		if (!ec)
+		{
+			bytes_read_ += size;
+		}
+	}
+}
+
+void Stats::Timer::file_written(const fs::path& path)
+{
+	std::error_code ec;
+	if (stats_)
+	{
+		auto size = fs::file_size(path, ec);
+		if (!ec)
+		{
+			bytes_written_ += size;
+		}
+	}
+}
+
+void Stats::Timer::resource(uint32_t type, int16_t id)
+{
+	resource_ = true;
+	type_ = type;
+	id_ = id;
+}
+
+Stats::Stats() :
+	start_(std::chrono::steady_clock::now())
+{
+}
+
+void Stats::Record(const Timer& timer, std::uint64_t nanoseconds, std::uint64_t allocations)
+{
+	auto& totals = phases_[timer.phase_];
+	totals.calls += 1;
+	totals.nanoseconds += nanoseconds;
+	totals.bytes_read += timer.bytes_read_;
+	totals.bytes_written += timer.bytes_written_;
+	totals.allocations += allocations;
+
+	if (timer.resource_)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (slowest_.size() < slowest_count || nanoseconds > slowest_.back().nanoseconds)
+		{
+			ResourceTime resource{timer.type_, timer.id_, timer.phase_, nanoseconds, timer.bytes_read_, timer.bytes_written_};
+			auto it = std::upper_bound(slowest_.begin(), slowest_.end(), nanoseconds, [](std::uint64_t n, const ResourceTime& r) { return n > r.nanoseconds; });
+			slowest_.insert(it, resource);
+			if (slowest_.size() > slowest_count)
+			{
+				slowest_.pop_back();
+			}
+		}
+	}
+}
+
+std::vector<Stats::ResourceTime> Stats::Slowest() const
+{
+	std::lock_guard<std::mutex> lock(mutex_);
+	return slowest_;
+}
+
+double Stats::Seconds() const
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+}
+
+void Stats::WriteJSON(std::ostream& out) const
+{
+	out << std::fixed << std::setprecision(6);
+	out << "{\"seconds\":" << Seconds() << ",\"phases\":[";
+
+	bool first = true;
+	for (auto phase = 0; phase < kPhaseCount; ++phase)
+	{
+		const auto& totals = phases_[phase];
+		if (totals.calls)
+		{
+			if (!first)
+			{
+				out << ",";
+			}
+			first = false;
+
+			out << "{\"phase\":\"" << phase_names[phase] << "\""
+				<< ",\"calls\":" << totals.calls
+				<< ",\"seconds\":" << seconds(totals.nanoseconds)
+				<< ",\"bytes_read\":" << totals.bytes_read
+				<< ",\"bytes_written\":" << totals.bytes_written
+				<< ",\"allocations\":" << totals.allocations << "}";
+		}
+	}
+
+	out << "],\"slowest\":[";
+
+	first = true;
+	for (const auto& resource : Slowest())
+	{
+		if (!first)
+		{
+			out << ",";
+		}
+		first = false;
+
+		out << "{\"type\":\"" << type_name(resource.type) << "\""
+			<< ",\"id\":" << resource.id
+			<< ",\"phase\":\"" << phase_names[resource.phase] << "\""
+			<< ",\"seconds\":" << seconds(resource.nanoseconds)
+			<< ",\"bytes_read\":" << resource.bytes_read
+			<< ",\"bytes_written\":" << resource.bytes_written << "}";
+	}
+
+	out << "]}" << std::endl;
+}
+
+// one table: a row per phase, then a row per slow resource
+void Stats::WriteCSV(std::ostream& out) const
+{
+	out << std::fixed << std::setprecision(6);
+	out << "record,name,calls,seconds,bytes_read,bytes_written,allocations" << std::endl;
+	for (auto phase = 0; phase < kPhaseCount; ++phase)
+	{
+		const auto& totals = phases_[phase];
+		if (totals.calls)
+		{
+			out << "phase," << phase_names[phase]
+				<< "," << totals.calls
+				<< "," << seconds(totals.nanoseconds)
+				<< "," << totals.bytes_read
+				<< "," << totals.bytes_written
+				<< "," << totals.allocations << std::endl;
+		}
+	}
+
+	for (const auto& resource : Slowest())
+	{
+		out << "resource," << type_name(resource.type) << " " << resource.id
+			<< ",1"
+			<< "," << seconds(resource.nanoseconds)
+			<< "," << resource.bytes_read
+			<< "," << resource.bytes_written
+			<< "," << std::endl;
+	}
+
+	out << "total,," << "," << Seconds() << ",,," << std::endl;
+}
+
+bool Stats::Save(const fs::path& path) const
+{
+	std::ofstream out(path, std::ios::trunc);
+	if (!out)
+	{
+		return false;
+	}
+
+	if (path.extension() == ".csv")
+	{
+		WriteCSV(out);
+	}
+	else
+	{
+		WriteJSON(out);
+	}
+
+	return static_cast<bool>(out);
+}
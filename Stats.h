@@ -0,0 +1,163 @@
+/* Stats.h
+
+   Copyright (C) 2026 by Gregory Smith
+   
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+   
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+   
+   This license is contained in the file "COPYING", which is included
+   with this source code; it is available online at
+   http://www.gnu.org/licenses/gpl.html
+   
+*/
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace atque
+{
+
+namespace detail
+{
+	// bumped by AllocationCounter.cpp's operator new, when it's linked in
+	// and counting is on
+	extern std::atomic<bool> count_allocations;
+	extern thread_local std::uint64_t allocation_count;
+}
+
+// where a split or merge spends its time: wall time, bytes and heap
+// allocations per phase, and the slowest few resources. Timers may run on
+// any number of threads at once
+class Stats
+{
+public:
+	enum Phase {
+		kLoad,       // reading the source and indexing it
+		kMapInfo,
+		kPhysics,
+		kShapes,
+		kSounds,
+		kTerminal,
+		kScripts,
+		kLevel,      // the map itself, whatever is left of the wad
+		kLink,
+		kPICT,
+		kSnd,
+		kCLUT,
+		kTEXT,
+		kTerm,       // Marathon 1 terminals
+		kResource,   // everything else, copied as is
+		kWrite,      // the finished scenario, or the level select names
+		kPhaseCount
+	};
+
+	static const char* PhaseName(Phase phase);
+
+	// times a phase from construction to destruction; with no stats it
+	// does nothing, not even read the clock
+	class Timer
+	{
+	public:
+		Timer(Stats* stats, Phase phase);
+		~Timer();
+
+		Timer(const Timer&) = delete;
+		Timer& operator=(const Timer&) = delete;
+
+		void bytes_read(std::uintmax_t bytes) { bytes_read_ += bytes; }
+		void bytes_written(std::uintmax_t bytes) { bytes_written_ += bytes; }
+
+		// adds the size of path, if it exists
+		void file_read(const std::filesystem::path& path);
+		void file_written(const std::filesystem::path& path);
+
+		// makes this one resource, a candidate for the slowest list
+		void resource(uint32_t type, int16_t id);
+
+		bool enabled() const { return stats_; }
+
+	private:
+		friend class Stats;
+
+		Stats* stats_;
+		Phase phase_;
+		std::chrono::steady_clock::time_point start_;
+		std::uint64_t allocations_ = 0;
+		std::uintmax_t bytes_read_ = 0;
+		std::uintmax_t bytes_written_ = 0;
+		bool resource_ = false;
+		uint32_t type_ = 0;
+		int16_t id_ = 0;
+	};
+
+	Stats();
+
+	// CSV if path ends in .csv, JSON otherwise
+	bool Save(const std::filesystem::path& path) const;
+
+	void WriteJSON(std::ostream& out) const;
+	void WriteCSV(std::ostream& out) const;
+
+	// heap allocations made so far on the calling thread. A Timer only
+	// sees those of the thread it runs on, so phases are timed on the
+	// threads that do their work, not around a pool
+	static std::uint64_t Allocations();
+
+	// starts counting, in programs that link AllocationCounter.cpp (the
+	// command line tools); until then, and in anything else, the
+	// allocation counts stay 0
+	static void CountAllocations();
+
+	// how many of the slowest resources to keep
+	static const int slowest_count = 10;
+
+private:
+	struct PhaseTotals {
+		std::atomic<std::uint64_t> calls{0};
+		std::atomic<std::uint64_t> nanoseconds{0};
+		std::atomic<std::uint64_t> bytes_read{0};
+		std::atomic<std::uint64_t> bytes_written{0};
+		std::atomic<std::uint64_t> allocations{0};
+	};
+
+	struct ResourceTime {
+		uint32_t type;
+		int16_t id;
+		Phase phase;
+		std::uint64_t nanoseconds;
+		std::uintmax_t bytes_read;
+		std::uintmax_t bytes_written;
+	};
+
+	void Record(const Timer& timer, std::uint64_t nanoseconds, std::uint64_t allocations);
+	std::vector<ResourceTime> Slowest() const;
+	double Seconds() const;
+
+	std::chrono::steady_clock::time_point start_;
+	std::array<PhaseTotals, kPhaseCount> phases_;
+
+	// sorted slowest first
+	mutable std::mutex mutex_;
+	std::vector<ResourceTime> slowest_;
+};
+
+}
+
+#endif
@@ -0,0 +1,155 @@
+/* ThreadPool.cpp
+
+   Copyright (C) 2026 by Gregory Smith
+   
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+   
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+   
+   This license is contained in the file "COPYING", which is included
+   with this source code; it is available online at
+   http://www.gnu.org/licenses/gpl.html
+   
+*/
+
+#include "ThreadPool.h"
+
+using namespace atque;
+
+ThreadPool::ThreadPool(int threads)
+{
+	if (threads < 1)
+	{
+		threads = 1;
+	}
+
+	for (int i = 0; i < threads; ++i)
+	{
+		threads_.emplace_back(&ThreadPool::Work, this);
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stopping_ = true;
+	}
+	condition_.notify_all();
+
+	// workers drain the queue before they exit
+	for (auto& thread : threads_)
+	{
+		thread.join();
+	}
+}
+
+std::future<void> ThreadPool::Submit(std::function<void()> job)
+{
+	std::packaged_task<void()> task(std::move(job));
+	auto future = task.get_future();
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		jobs_.push_back(std::move(task));
+	}
+	condition_.notify_one();
+
+	return future;
+}
+
+int ThreadPool::DefaultThreads()
+{
+	auto threads = std::thread::hardware_concurrency();
+	return threads ? threads : 1;
+}
+
+void ThreadPool::Work()
+{
+	for (;;)
+	{
+		std::packaged_task<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			condition_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+			if (jobs_.empty())
+			{
+				return;
+			}
+
+			task = std::move(jobs_.front());
+			jobs_.pop_front();
+		}
+
+		task();
+	}
+}
+
+OrderedJobs::OrderedJobs(int jobs)
+{
+	if (jobs > 1)
+	{
+		pool_ = std::make_unique<ThreadPool>(jobs);
+	}
+}
+
+OrderedJobs::~OrderedJobs()
+{
+	// an exception on the way out shouldn't wait on the whole queue
+	Cancel();
+}
+
+void OrderedJobs::Add(std::function<void()> work, std::function<void()> finish)
+{
+	if (pool_)
+	{
+		// a skipped job's finish never runs: everything after the
+		// failure in order is skipped, and Finish stops at the failure
+		jobs_.emplace_back(pool_->Submit([this, work = std::move(work)]() {
+			if (cancelled_)
+			{
+				return;
+			}
+
+			try
+			{
+				work();
+			}
+			catch (...)
+			{
+				Cancel();
+				throw;
+			}
+		}), std::move(finish));
+	}
+	else
+	{
+		work();
+		finish();
+	}
+}
+
+void OrderedJobs::Finish()
+{
+	try
+	{
+		while (!jobs_.empty())
+		{
+			auto job = std::move(jobs_.front());
+			jobs_.pop_front();
+
+			job.first.get();
+			job.second();
+		}
+	}
+	catch (...)
+	{
+		Cancel();
+		throw;
+	}
+}
@@ -0,0 +1,95 @@
+/* ThreadPool.h
+
+   Copyright (C) 2026 by Gregory Smith
+   
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+   
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+   
+   This license is contained in the file "COPYING", which is included
+   with this source code; it is available online at
+   http://www.gnu.org/licenses/gpl.html
+   
+*/
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace atque
+{
+
+// fixed number of worker threads pulling jobs off a FIFO queue;
+// exceptions thrown by a job come back through its future
+class ThreadPool
+{
+public:
+	explicit ThreadPool(int threads);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	std::future<void> Submit(std::function<void()> job);
+	int size() const { return static_cast<int>(threads_.size()); }
+
+	// what -j 0 means
+	static int DefaultThreads();
+
+private:
+	void Work();
+
+	std::vector<std::thread> threads_;
+	std::deque<std::packaged_task<void()> > jobs_;
+	std::mutex mutex_;
+	std::condition_variable condition_;
+	bool stopping_ = false;
+};
+
+// work runs on a pool, but each finish runs on the calling thread, in the
+// order it was added, once Finish is called; with one job, work and
+// finish both run right away, exactly as a serial loop would. Once a job
+// fails, work that hasn't started yet is skipped
+class OrderedJobs
+{
+public:
+	explicit OrderedJobs(int jobs);
+	~OrderedJobs();
+
+	OrderedJobs(const OrderedJobs&) = delete;
+	OrderedJobs& operator=(const OrderedJobs&) = delete;
+
+	void Add(std::function<void()> work, std::function<void()> finish);
+
+	// rethrows the first exception, in order, from either half
+	void Finish();
+
+	// skips the work not yet started; for work that holds on to its own
+	// error until its finish, since a throw cancels by itself
+	void Cancel() { cancelled_ = true; }
+
+private:
+	// before pool_, so it outlives the workers
+	std::atomic<bool> cancelled_{false};
+	std::unique_ptr<ThreadPool> pool_;
+	std::deque<std::pair<std::future<void>, std::function<void()> > > jobs_;
+};
+
+}
+
+#endif
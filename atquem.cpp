@@ -18,28 +18,221 @@
    
 */
 
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
 #include <string>
 #include <vector>
 
+#include "Batch.h"
 #include "merge.h"
+#include "Stats.h"
+#include "ThreadPool.h"
+
+static void usage()
+{
+	std::cerr << "Usage: atquem [-j jobs] [--fork macbinary|appledouble|xattr] [--stats path] <source> <dest>" << std::endl;
+	std::cerr << "       atquem --update <level_folder> <dest>" << std::endl;
+	std::cerr << "       atquem [-j jobs] [--in-flight MB] [--fork format] --batch <manifest>" << std::endl;
+	std::cerr << "  --fork       where to put the resource fork: a MacBinary file (the" << std::endl;
+	std::cerr << "               default), an AppleDouble ._ file, or an extended attribute" << std::endl;
+	std::cerr << "  --update     replace one level in an existing scenario, leaving the" << std::endl;
+	std::cerr << "               other levels' bytes alone" << std::endl;
+	std::cerr << "  --batch      merge every source<TAB>dest line of manifest (- for stdin)," << std::endl;
+	std::cerr << "               -j at a time, printing a JSON result line for each" << std::endl;
+	std::cerr << "  --in-flight  only start jobs while running sources total less than MB" << std::endl;
+	std::cerr << "  --stats      write per-phase times, bytes and allocations, and the" << std::endl;
+	std::cerr << "               slowest resources, to path (CSV if it ends in .csv, else JSON)" << std::endl;
+}
+
+static bool save_stats(const atque::Stats& stats, const std::string& path)
+{
+	if (path.size() && !stats.Save(path))
+	{
+		std::cerr << "atquem: could not write " << path << std::endl;
+		return false;
+	}
+
+	return true;
+}
 
 int main(int argc, char *argv[])
 {
-	if (argc != 3)
+	atque::merge_options options;
+	bool update = false;
+	bool jobs_given = false;
+	bool fork_given = false;
+	std::string manifest;
+	atque::batch_options batch_options;
+	std::string stats_path;
+	atque::Stats stats;
+
+	int arg = 1;
+	while (arg < argc && argv[arg][0] == '-')
+	{
+		std::string option = argv[arg];
+		if (option == "-j" && arg + 1 < argc)
+		{
+			char* end;
+			long jobs = std::strtol(argv[arg + 1], &end, 10);
+			if (*end || jobs < 0)
+			{
+				usage();
+				return 1;
+			}
+
+			options.jobs = jobs ? jobs : atque::ThreadPool::DefaultThreads();
+			jobs_given = true;
+			arg += 2;
+		}
+		else if (option == "--fork" && arg + 1 < argc)
+		{
+			using ForkFormat = marathon::ResourceManager::ForkFormat;
+			
+			std::string format = argv[arg + 1];
+			if (format == "macbinary")
+			{
+				options.fork_format = ForkFormat::MacBinary;
+			}
+			else if (format == "appledouble")
+			{
+				options.fork_format = ForkFormat::AppleDouble;
+			}
+			else if (format == "xattr")
+			{
+				options.fork_format = ForkFormat::ExtendedAttribute;
+			}
+			else
+			{
+				usage();
+				return 1;
+			}
+			fork_given = true;
+			arg += 2;
+		}
+		else if (option == "--batch" && arg + 1 < argc)
+		{
+			manifest = argv[arg + 1];
+			arg += 2;
+		}
+		else if (option == "--in-flight" && arg + 1 < argc)
+		{
+			char* end;
+			long long megabytes = std::strtoll(argv[arg + 1], &end, 10);
+			if (*end || megabytes <= 0)
+			{
+				usage();
+				return 1;
+			}
+
+			batch_options.max_in_flight_bytes = static_cast<std::uintmax_t>(megabytes) << 20;
+			arg += 2;
+		}
+		else if (option == "--stats" && arg + 1 < argc)
+		{
+			stats_path = argv[arg + 1];
+			arg += 2;
+		}
+		else if (option.compare(0, 8, "--stats=") == 0 && option.size() > 8)
+		{
+			stats_path = option.substr(8);
+			++arg;
+		}
+		else if (option == "--update")
+		{
+			update = true;
+			++arg;
+		}
+		else
+		{
+			usage();
+			return 1;
+		}
+	}
+
+	// update rewrites one level by itself, and has none of these
+	if (update && (jobs_given || fork_given || stats_path.size() || manifest.size()))
+	{
+		std::cerr << "atquem: --update can't be combined with -j, --fork, --stats or --batch" << std::endl;
+		usage();
+		return 1;
+	}
+
+	if (stats_path.size())
+	{
+		options.stats = &stats;
+		atque::Stats::CountAllocations();
+	}
+
+	if (manifest.size())
+	{
+		if (argc != arg)
+		{
+			usage();
+			return 1;
+		}
+
+		try {
+			std::vector<atque::batch_job> jobs;
+			if (manifest == "-")
+			{
+				jobs = atque::read_manifest(std::cin);
+			}
+			else
+			{
+				std::ifstream stream(manifest);
+				if (!stream)
+				{
+					std::cerr << "atquem: could not open " << manifest << std::endl;
+					return 1;
+				}
+				jobs = atque::read_manifest(stream);
+			}
+
+			// the pool runs whole jobs, so each one runs serially
+			batch_options.jobs = options.jobs;
+			options.jobs = 1;
+
+			auto failed = atque::run_batch(jobs, [&options](const atque::batch_job& job, std::ostream& log) {
+				atque::merge(job.source, job.destination, log, options);
+			}, std::cout, std::cerr, batch_options);
+
+			if (!save_stats(stats, stats_path))
+			{
+				return 1;
+			}
+
+			return failed ? 1 : 0;
+		}
+		catch (const std::runtime_error& e)
+		{
+			std::cerr << "atquem: " << e.what() << std::endl;
+			return 1;
+		}
+	}
+
+	if (argc - arg != 2)
 	{
-		std::cerr << "Usage: atquem <source> <dest>" << std::endl;
+		usage();
 		return 1;
 	}
 
 	try {
-		atque::merge(argv[1], argv[2], std::cout);
+		if (update)
+		{
+			atque::update(argv[arg], argv[arg + 1], std::cout);
+		}
+		else
+		{
+			atque::merge(argv[arg], argv[arg + 1], std::cout, options);
+		}
 	}
 	catch (const atque::merge_error& e)
 	{
 		std::cerr << "atquem: " << e.what() << std::endl;
+		return 1;
 	}
 
-	return 0;
+	return save_stats(stats, stats_path) ? 0 : 1;
 }
-
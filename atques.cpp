@@ -18,20 +18,211 @@
    
 */
 
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
+#include <string>
+#include <vector>
 
+#include "Batch.h"
 #include "split.h"
+#include "Stats.h"
+#include "ThreadPool.h"
+
+static void usage()
+{
+	std::cerr << "Usage: atques [-j jobs] [--link-duplicates] [--level n]... [--resources] [--verify] [--stats path] <source> <dest_folder>" << std::endl;
+	std::cerr << "       atques [--verify] --list <source>" << std::endl;
+	std::cerr << "       atques [-j jobs] [--in-flight MB] [options] --batch <manifest>" << std::endl;
+	std::cerr << "  --level n    write only level n; may be repeated. Resources are" << std::endl;
+	std::cerr << "               skipped unless --resources is given" << std::endl;
+	std::cerr << "  --list       print the levels and resources in source" << std::endl;
+	std::cerr << "  --verify     fail if the wadfile's checksum does not match (reads the" << std::endl;
+	std::cerr << "               whole file)" << std::endl;
+	std::cerr << "  --batch      split every source<TAB>dest line of manifest (- for stdin)," << std::endl;
+	std::cerr << "               -j at a time, printing a JSON result line for each" << std::endl;
+	std::cerr << "  --in-flight  only start jobs while running sources total less than MB" << std::endl;
+	std::cerr << "  --stats      write per-phase times, bytes and allocations, and the" << std::endl;
+	std::cerr << "               slowest resources, to path (CSV if it ends in .csv, else JSON)" << std::endl;
+}
+
+static bool save_stats(const atque::Stats& stats, const std::string& path)
+{
+	if (path.size() && !stats.Save(path))
+	{
+		std::cerr << "atques: could not write " << path << std::endl;
+		return false;
+	}
+
+	return true;
+}
 
 int main(int argc, char *argv[])
 {
-	if (argc != 3)
+	atque::split_options options;
+	bool resources = false;
+	bool list = false;
+	std::string manifest;
+	atque::batch_options batch_options;
+	std::string stats_path;
+	atque::Stats stats;
+
+	int arg = 1;
+	while (arg < argc && argv[arg][0] == '-')
+	{
+		std::string option = argv[arg];
+		if (option == "-j" && arg + 1 < argc)
+		{
+			char* end;
+			long jobs = std::strtol(argv[arg + 1], &end, 10);
+			if (*end || jobs < 0)
+			{
+				usage();
+				return 1;
+			}
+
+			options.jobs = jobs ? jobs : atque::ThreadPool::DefaultThreads();
+			arg += 2;
+		}
+		else if (option == "--link-duplicates")
+		{
+			options.link_duplicates = true;
+			++arg;
+		}
+		else if (option == "--level" && arg + 1 < argc)
+		{
+			char* end;
+			long level = std::strtol(argv[arg + 1], &end, 10);
+			if (*end || level < 0 || level > INT16_MAX)
+			{
+				usage();
+				return 1;
+			}
+
+			options.levels.insert(level);
+			arg += 2;
+		}
+		else if (option == "--batch" && arg + 1 < argc)
+		{
+			manifest = argv[arg + 1];
+			arg += 2;
+		}
+		else if (option == "--in-flight" && arg + 1 < argc)
+		{
+			char* end;
+			long long megabytes = std::strtoll(argv[arg + 1], &end, 10);
+			if (*end || megabytes <= 0)
+			{
+				usage();
+				return 1;
+			}
+
+			batch_options.max_in_flight_bytes = static_cast<std::uintmax_t>(megabytes) << 20;
+			arg += 2;
+		}
+		else if (option == "--list")
+		{
+			list = true;
+			++arg;
+		}
+		else if (option == "--stats" && arg + 1 < argc)
+		{
+			stats_path = argv[arg + 1];
+			arg += 2;
+		}
+		else if (option.compare(0, 8, "--stats=") == 0 && option.size() > 8)
+		{
+			stats_path = option.substr(8);
+			++arg;
+		}
+		else if (option == "--resources")
+		{
+			resources = true;
+			++arg;
+		}
+		else if (option == "--verify")
+		{
+			options.verify = true;
+			++arg;
+		}
+		else
+		{
+			usage();
+			return 1;
+		}
+	}
+
+	options.resources = options.levels.empty() || resources;
+
+	if (stats_path.size())
+	{
+		options.stats = &stats;
+		atque::Stats::CountAllocations();
+	}
+
+	if (manifest.size())
+	{
+		if (argc != arg)
+		{
+			usage();
+			return 1;
+		}
+
+		try {
+			std::vector<atque::batch_job> jobs;
+			if (manifest == "-")
+			{
+				jobs = atque::read_manifest(std::cin);
+			}
+			else
+			{
+				std::ifstream stream(manifest);
+				if (!stream)
+				{
+					std::cerr << "atques: could not open " << manifest << std::endl;
+					return 1;
+				}
+				jobs = atque::read_manifest(stream);
+			}
+
+			// the pool runs whole jobs, so each one runs serially
+			batch_options.jobs = options.jobs;
+			options.jobs = 1;
+
+			auto failed = atque::run_batch(jobs, [&options](const atque::batch_job& job, std::ostream& log) {
+				atque::split(job.source, job.destination, log, options);
+			}, std::cout, std::cerr, batch_options);
+
+			if (!save_stats(stats, stats_path))
+			{
+				return 1;
+			}
+
+			return failed ? 1 : 0;
+		}
+		catch (const std::runtime_error& e)
+		{
+			std::cerr << "atques: " << e.what() << std::endl;
+			return 1;
+		}
+	}
+
+	if (argc - arg != (list ? 1 : 2))
 	{
-		std::cerr << "Usage: atques <source> <dest_folder>" << std::endl;
+		usage();
 		return 1;
 	}
 
 	try {
-		atque::split(argv[1], argv[2], std::cout);
+		if (list)
+		{
+			atque::list(argv[arg], std::cout, options.verify);
+		}
+		else
+		{
+			atque::split(argv[arg], argv[arg + 1], std::cout, options);
+		}
 	}
 	catch (const atque::split_error& e)
 	{
@@ -39,5 +230,5 @@ int main(int argc, char *argv[])
 		return 1;
 	}
 
-	return 0;
+	return save_stats(stats, stats_path) ? 0 : 1;
 }
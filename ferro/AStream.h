@@ -24,10 +24,19 @@
 #define __ASTREAM_H
 
 #include <string>
+#include <cstdlib>
+#include <cstring>
 #include <exception>
 #include <iostream>
+#include <boost/endian/conversion.hpp>
 #include "ferro/cstypes.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
 namespace AStream
 {
 enum _Aiostate { _M_aiostate_end = 1L << 16 };
@@ -42,11 +51,11 @@ static const iostate goodbit = iostate(0);
 class failure : public std::exception
 {
 public:
-    failure(const std::string& __str) throw();
-    failure(const failure &f);
-    ~failure() throw();
+    failure(const std::string& __str) throw() : _M_name(strdup(__str.c_str())) {}
+    failure(const failure &f) : _M_name(f._M_name ? strdup(f._M_name) : NULL) {}
+    ~failure() throw() { free(_M_name); }
     const char*
-    what() const throw();
+    what() const throw() { return _M_name; }
 
 private:
     char * _M_name;
@@ -63,7 +72,20 @@ private:
 protected:
     T *_M_stream_pos;
     
-    bool  bound_check(uint32 __delta);
+    bool bound_check(uint32 __delta) {
+        if (__delta > uint32(_M_stream_end - _M_stream_pos)) {
+            return bound_check_failed();
+        }
+        return !(this->fail());
+    }
+
+    bool bound_check_failed() {
+        this->setstate(failbit);
+        if ((this->exceptions() & failbit) != 0) {
+            throw failure("serialization bound check failed");
+        }
+        return false;
+    }
 		
     uint32 tell_pos() const { return _M_stream_pos - _M_stream_begin; } 
     uint32 max_pos() const { return _M_stream_end - _M_stream_begin; }
@@ -97,6 +119,41 @@ public:
 
     virtual ~basic_astream() {};
 };
+
+// reverse the bytes of every 2- or 4-byte element of a buffer in place;
+// the vector loops handle 16 bytes at a time and the scalar loop mops up
+// the tail. The buffer need not be aligned.
+template<size_t _Size>
+inline void byte_swap(uint8 *__buffer, uint32 __count)
+{
+    static_assert(_Size == 2 || _Size == 4, "only 16- and 32-bit elements");
+    uint32 k = 0;
+#if defined(__SSE2__)
+    for (; k + 16 / _Size <= __count; k += 16 / _Size) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(__buffer + k * _Size));
+        if (_Size == 4) {
+            // swap the 16-bit halves of each word first
+            v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+            v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+        }
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(__buffer + k * _Size), v);
+    }
+#elif defined(__ARM_NEON)
+    for (; k + 16 / _Size <= __count; k += 16 / _Size) {
+        uint8x16_t v = vld1q_u8(__buffer + k * _Size);
+        vst1q_u8(__buffer + k * _Size, _Size == 4 ? vrev32q_u8(v) : vrev16q_u8(v));
+    }
+#endif
+    for (; k < __count; ++k) {
+        uint8 *p = __buffer + k * _Size;
+        for (size_t b = 0; b < _Size / 2; ++b) {
+            uint8 t = p[b];
+            p[b] = p[_Size - 1 - b];
+            p[_Size - 1 - b] = t;
+        }
+    }
+}
 }
 
 /* Input Streams, deserializing */
@@ -110,15 +167,35 @@ public:
     uint32 tellg() const { return this->tell_pos(); }
     uint32 maxg() const { return this->max_pos(); }
     
-    AIStream& operator>>(uint8 &__value);
-    AIStream& operator>>(int8 &__value);
+    AIStream& operator>>(uint8 &__value) {
+        if (bound_check(1)) {
+            __value = *(_M_stream_pos++);
+        } else {
+            __value = 0;
+        }
+        return *this;
+    }
+
+    AIStream& operator>>(int8 &__value) {
+        uint8 UValue;
+        operator>>(UValue);
+        __value = int8(UValue);
+        return *this;
+    }
 
     virtual AIStream& operator>>(uint16 &__value) = 0;
     virtual AIStream& operator>>(int16 &__value) = 0;
     virtual AIStream& operator>>(uint32 &__value) = 0;
     virtual AIStream& operator>>(int32 &__value) = 0;
 
-    AIStream& read(char *__ptr, uint32 __count);
+    AIStream& read(char *__ptr, uint32 __count) {
+        if (bound_check(__count)) {
+            std::memcpy(__ptr, _M_stream_pos, __count);
+            _M_stream_pos += __count;
+        }
+        return *this;
+    }
+
     AIStream& read(unsigned char * __ptr, uint32 __count) {
         return read((char *) __ptr, __count);
     }
@@ -127,7 +204,23 @@ public:
         return read((char *) __ptr, __count);
     }
 	
-    AIStream& ignore(uint32 __count);
+    AIStream& ignore(uint32 __count) {
+        if (bound_check(__count)) {
+            _M_stream_pos += __count;
+        }
+        return *this;
+    }
+
+    // the next __count bytes, in place, skipping over them; null if they
+    // aren't all there and exceptions are off
+    const uint8* view(uint32 __count) {
+        if (bound_check(__count)) {
+            const uint8* __ptr = _M_stream_pos;
+            _M_stream_pos += __count;
+            return __ptr;
+        }
+        return nullptr;
+    }
 
     // Uses >> instead of operator>> so as to pick up friendly operator>>
     template<class T>
@@ -140,44 +233,104 @@ public:
     };
 };
 
-class AIStreamBE : public AIStream
+// The byte order is fixed at compile time and the overrides are final,
+// so a call through one of these (or AIStreamBE/AIStreamLE) is inlined
+// rather than dispatched through AIStream's vtable
+template <boost::endian::order _Order>
+class basic_aistream : public AIStream
 {
 public:
-    AIStreamBE(const uint8* __stream, uint32 __length, uint32 __offset = 0) :
-        AIStream(__stream, __length, __offset) {};
+    basic_aistream(const uint8* __stream, uint32 __length, uint32 __offset = 0) :
+        AIStream(__stream, __length, __offset) {}
 
-    AIStream& operator>>(uint8 &__value) {
-        return AIStream::operator>>(__value);
+    basic_aistream& operator>>(uint8 &__value) {
+        AIStream::operator>>(__value);
+        return *this;
     }
 
-    AIStream& operator>>(int8 &__value) {
-        return AIStream::operator>>(__value);
+    basic_aistream& operator>>(int8 &__value) {
+        uint8 UValue;
+        operator>>(UValue);
+        __value = int8(UValue);
+        return *this;
     }
-	
-    AIStream& operator>>(uint16 &__value);
-    AIStream& operator>>(int16 &__value);
-    AIStream& operator>>(uint32 &__value);
-    AIStream& operator>>(int32 &__value);
-};
 
-class AIStreamLE : public AIStream
-{
-public:
-    AIStreamLE(const uint8* __stream, uint32 __length, uint32 __offset = 0) :
-        AIStream(__stream, __length, __offset) {};
+    basic_aistream& operator>>(uint16 &__value) final { return extract(__value); }
+    basic_aistream& operator>>(int16 &__value) final { return extract(__value); }
+    basic_aistream& operator>>(uint32 &__value) final { return extract(__value); }
+    basic_aistream& operator>>(int32 &__value) final { return extract(__value); }
 
-    AIStream& operator>>(uint8 &__value) {
-        return AIStream::operator>>(__value);
+    basic_aistream& read(char *__ptr, uint32 __count) {
+        AIStream::read(__ptr, __count);
+        return *this;
     }
 
-    AIStream& operator>>(int8 &__value) {
-        return AIStream::operator>>(__value);
+    basic_aistream& read(unsigned char *__ptr, uint32 __count) {
+        return read((char *) __ptr, __count);
+    }
+
+    basic_aistream& read(signed char *__ptr, uint32 __count) {
+        return read((char *) __ptr, __count);
+    }
+
+    // whole arrays of integers: one bound check, one copy, one swap
+    basic_aistream& read(uint16 *__list, uint32 __count) { return extract(__list, __count); }
+    basic_aistream& read(int16 *__list, uint32 __count) { return extract(__list, __count); }
+    basic_aistream& read(uint32 *__list, uint32 __count) { return extract(__list, __count); }
+    basic_aistream& read(int32 *__list, uint32 __count) { return extract(__list, __count); }
+
+    template<class T>
+    basic_aistream& read(T* __list, uint32 __count) {
+        for (uint32 k = 0; k < __count; ++k)
+            *this >> __list[k];
+
+        return *this;
     }
 
-    AIStream& operator>>(uint16 &__value);
-    AIStream& operator>>(int16 &__value);
-    AIStream& operator>>(uint32 &__value);
-    AIStream& operator>>(int32 &__value);
+    basic_aistream& ignore(uint32 __count) {
+        AIStream::ignore(__count);
+        return *this;
+    }
+
+private:
+    // a value that isn't there reads as 0 when exceptions are off
+    template<class T>
+    basic_aistream& extract(T &__value) {
+        if (bound_check(sizeof(T))) {
+            std::memcpy(&__value, _M_stream_pos, sizeof(T));
+            boost::endian::conditional_reverse_inplace<_Order, boost::endian::order::native>(__value);
+            _M_stream_pos += sizeof(T);
+        } else {
+            __value = 0;
+        }
+        return *this;
+    }
+
+    template<class T>
+    basic_aistream& extract(T *__list, uint32 __count) {
+        if (__count > max_pos() / sizeof(T)) {
+            bound_check_failed();
+        } else if (bound_check(__count * sizeof(T))) {
+            std::memcpy(__list, _M_stream_pos, __count * sizeof(T));
+            if (_Order != boost::endian::order::native) {
+                AStream::byte_swap<sizeof(T)>(reinterpret_cast<uint8*>(__list), __count);
+            }
+            _M_stream_pos += __count * sizeof(T);
+        }
+        return *this;
+    }
+};
+
+class AIStreamBE final : public basic_aistream<boost::endian::order::big>
+{
+public:
+    using basic_aistream::basic_aistream;
+};
+
+class AIStreamLE final : public basic_aistream<boost::endian::order::little>
+{
+public:
+    using basic_aistream::basic_aistream;
 };
 
 /* Output Streams, serializing */
@@ -191,14 +344,30 @@ public:
     uint32 tellp() const { return this->tell_pos(); }
     uint32 maxp() const { return this->max_pos(); }
 		
-    AOStream& operator<<(uint8 __value);
-    AOStream& operator<<(int8 __value);
+    AOStream& operator<<(uint8 __value) {
+        if (bound_check(1)) {
+            *(_M_stream_pos++) = __value;
+        }
+        return *this;
+    }
+
+    AOStream& operator<<(int8 __value) {
+        return operator<<(uint8(__value));
+    }
+
     virtual AOStream& operator<<(uint16 __value) = 0;
     virtual AOStream& operator<<(int16 __value) = 0;
     virtual AOStream& operator<<(uint32 __value) = 0;
     virtual AOStream& operator<<(int32 __value) = 0;
 
-    AOStream& write(const char *__ptr, uint32 __count);
+    AOStream& write(const char *__ptr, uint32 __count) {
+        if (bound_check(__count)) {
+            std::memcpy(_M_stream_pos, __ptr, __count);
+            _M_stream_pos += __count;
+        }
+        return *this;
+    }
+
     AOStream& write(const unsigned char * __ptr, uint32 __count) {
         return write((char *) __ptr, __count);
     }
@@ -207,7 +376,12 @@ public:
         return write((char *) __ptr, __count);
     }
 	
-    AOStream& ignore(uint32 __count);
+    AOStream& ignore(uint32 __count) {
+        if (bound_check(__count)) {
+            _M_stream_pos += __count;
+        }
+        return *this;
+    }
 
     // Uses << instead of operator<< so as to pick up friendly operator<<
     template<class T>
@@ -220,44 +394,95 @@ public:
     }
 };
 
-class AOStreamBE: public AOStream
+template <boost::endian::order _Order>
+class basic_aostream : public AOStream
 {
 public:
-    AOStreamBE(uint8* __stream, uint32 __length, uint32 __offset = 0) :
-        AOStream(__stream, __length, __offset) {};
+    basic_aostream(uint8* __stream, uint32 __length, uint32 __offset = 0) :
+        AOStream(__stream, __length, __offset) {}
 
-    AOStream& operator<<(uint8 __value) {
-        return AOStream::operator<<(__value);
+    basic_aostream& operator<<(uint8 __value) {
+        AOStream::operator<<(__value);
+        return *this;
     }
-    
-    AOStream& operator<<(int8 __value) {
-        return AOStream::operator<<(__value);
+
+    basic_aostream& operator<<(int8 __value) {
+        return operator<<(uint8(__value));
     }
-    
-    AOStream& operator<<(uint16 __value);
-    AOStream& operator<<(int16 __value);
-    AOStream& operator<<(uint32 __value);
-    AOStream& operator<<(int32 __value);
-};
 
-class AOStreamLE: public AOStream
-{
-public:
-    AOStreamLE(uint8* __stream, uint32 __length, uint32 __offset = 0) :
-        AOStream(__stream, __length, __offset) {}
+    basic_aostream& operator<<(uint16 __value) final { return insert(__value); }
+    basic_aostream& operator<<(int16 __value) final { return insert(__value); }
+    basic_aostream& operator<<(uint32 __value) final { return insert(__value); }
+    basic_aostream& operator<<(int32 __value) final { return insert(__value); }
 
-    AOStream& operator<<(uint8 __value) {
-        return AOStream::operator<<(__value);
+    basic_aostream& write(const char *__ptr, uint32 __count) {
+        AOStream::write(__ptr, __count);
+        return *this;
     }
 
-    AOStream& operator<<(int8 __value) {
-        return AOStream::operator<<(__value);
+    basic_aostream& write(const unsigned char *__ptr, uint32 __count) {
+        return write((const char *) __ptr, __count);
+    }
+
+    basic_aostream& write(const signed char *__ptr, uint32 __count) {
+        return write((const char *) __ptr, __count);
     }
- 
-    AOStream& operator<<(uint16 __value);
-    AOStream& operator<<(int16 __value);
-    AOStream& operator<<(uint32 __value);
-    AOStream& operator<<(int32 __value);
+
+    basic_aostream& write(const uint16 *__list, uint32 __count) { return insert(__list, __count); }
+    basic_aostream& write(const int16 *__list, uint32 __count) { return insert(__list, __count); }
+    basic_aostream& write(const uint32 *__list, uint32 __count) { return insert(__list, __count); }
+    basic_aostream& write(const int32 *__list, uint32 __count) { return insert(__list, __count); }
+
+    template<class T>
+    basic_aostream& write(const T* __list, uint32 __count) {
+        for (uint32 k = 0; k < __count; ++k)
+            *this << __list[k];
+
+        return *this;
+    }
+
+    basic_aostream& ignore(uint32 __count) {
+        AOStream::ignore(__count);
+        return *this;
+    }
+
+private:
+    template<class T>
+    basic_aostream& insert(T __value) {
+        if (bound_check(sizeof(T))) {
+            boost::endian::conditional_reverse_inplace<boost::endian::order::native, _Order>(__value);
+            std::memcpy(_M_stream_pos, &__value, sizeof(T));
+            _M_stream_pos += sizeof(T);
+        }
+        return *this;
+    }
+
+    // swaps in the destination buffer, so the caller's array is untouched
+    template<class T>
+    basic_aostream& insert(const T *__list, uint32 __count) {
+        if (__count > max_pos() / sizeof(T)) {
+            bound_check_failed();
+        } else if (bound_check(__count * sizeof(T))) {
+            std::memcpy(_M_stream_pos, __list, __count * sizeof(T));
+            if (_Order != boost::endian::order::native) {
+                AStream::byte_swap<sizeof(T)>(_M_stream_pos, __count);
+            }
+            _M_stream_pos += __count * sizeof(T);
+        }
+        return *this;
+    }
+};
+
+class AOStreamBE final : public basic_aostream<boost::endian::order::big>
+{
+public:
+    using basic_aostream::basic_aostream;
+};
+
+class AOStreamLE final : public basic_aostream<boost::endian::order::little>
+{
+public:
+    using basic_aostream::basic_aostream;
 };
 
 #endif
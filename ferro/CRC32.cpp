@@ -0,0 +1,378 @@
+/* CRC32.cpp
+
+   Copyright (C) 2026 by Gregory Smith
+   
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+   
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+   
+   This license is contained in the file "COPYING", which is included
+   with this source code; it is available online at
+   http://www.gnu.org/licenses/gpl.html
+   
+*/
+
+#include "ferro/CRC32.h"
+
+#include <cstdint>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define CRC32_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__GNUC__)
+#define CRC32_ARM 1
+#include <arm_acle.h>
+#if defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
+
+using namespace marathon;
+
+namespace {
+
+const uint32 kPolynomial = 0xedb88320;
+
+struct SliceTables
+{
+	uint32 table[16][256];
+
+	SliceTables()
+	{
+		for (uint32 i = 0; i < 256; ++i)
+		{
+			uint32 crc = i;
+			for (int bit = 0; bit < 8; ++bit)
+			{
+				crc = (crc >> 1) ^ ((crc & 1) ? kPolynomial : 0);
+			}
+			table[0][i] = crc;
+		}
+
+		for (uint32 i = 0; i < 256; ++i)
+		{
+			for (int slice = 1; slice < 16; ++slice)
+			{
+				table[slice][i] = (table[slice - 1][i] >> 8) ^ table[0][table[slice - 1][i] & 0xff];
+			}
+		}
+	}
+};
+
+const SliceTables slice_tables;
+
+uint32 update_bytes(uint32 crc, const uint8* p, std::size_t n)
+{
+	const auto& t = slice_tables.table;
+	while (n--)
+	{
+		crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xff];
+	}
+
+	return crc;
+}
+
+// slicing-by-8: eight table lookups per eight bytes
+uint32 update_slice8(uint32 crc, const uint8* p, std::size_t n)
+{
+	const auto& t = slice_tables.table;
+	while (n >= 8)
+	{
+		uint32 one = crc ^ (p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32>(p[3]) << 24));
+		uint32 two = p[4] | (p[5] << 8) | (p[6] << 16) | (static_cast<uint32>(p[7]) << 24);
+		crc = t[7][one & 0xff] ^ t[6][(one >> 8) & 0xff] ^ t[5][(one >> 16) & 0xff] ^ t[4][one >> 24] ^
+			t[3][two & 0xff] ^ t[2][(two >> 8) & 0xff] ^ t[1][(two >> 16) & 0xff] ^ t[0][two >> 24];
+
+		p += 8;
+		n -= 8;
+	}
+
+	return update_bytes(crc, p, n);
+}
+
+// slicing-by-16: twice the tables, for a little more than slicing-by-8
+// manages, when there's no CRC hardware
+uint32 update_slice16(uint32 crc, const uint8* p, std::size_t n)
+{
+	const auto& t = slice_tables.table;
+	while (n >= 16)
+	{
+		uint32 one = crc ^ (p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32>(p[3]) << 24));
+		uint32 two = p[4] | (p[5] << 8) | (p[6] << 16) | (static_cast<uint32>(p[7]) << 24);
+		uint32 three = p[8] | (p[9] << 8) | (p[10] << 16) | (static_cast<uint32>(p[11]) << 24);
+		uint32 four = p[12] | (p[13] << 8) | (p[14] << 16) | (static_cast<uint32>(p[15]) << 24);
+		crc = t[15][one & 0xff] ^ t[14][(one >> 8) & 0xff] ^ t[13][(one >> 16) & 0xff] ^ t[12][one >> 24] ^
+			t[11][two & 0xff] ^ t[10][(two >> 8) & 0xff] ^ t[9][(two >> 16) & 0xff] ^ t[8][two >> 24] ^
+			t[7][three & 0xff] ^ t[6][(three >> 8) & 0xff] ^ t[5][(three >> 16) & 0xff] ^ t[4][three >> 24] ^
+			t[3][four & 0xff] ^ t[2][(four >> 8) & 0xff] ^ t[1][(four >> 16) & 0xff] ^ t[0][four >> 24];
+
+		p += 16;
+		n -= 16;
+	}
+
+	return update_slice8(crc, p, n);
+}
+
+#ifdef CRC32_X86
+
+// folds 64 bytes at a time with PCLMULQDQ, then Barrett reduces; see
+// Intel's "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ
+// Instruction". Needs at least 64 bytes, and a multiple of 16.
+__attribute__((target("pclmul,sse4.1")))
+uint32 fold_pclmul(uint32 crc, const uint8* p, std::size_t n)
+{
+	alignas(16) static const uint64_t k1k2[] = { 0x0154442bd4, 0x01c6e41596 };
+	alignas(16) static const uint64_t k3k4[] = { 0x01751997d0, 0x00ccaa009e };
+	alignas(16) static const uint64_t k5k0[] = { 0x0163cd6124, 0x0000000000 };
+	alignas(16) static const uint64_t poly[] = { 0x01db710641, 0x01f7011641 };
+
+	__m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+	x1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 0x00));
+	x2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 0x10));
+	x3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 0x20));
+	x4 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 0x30));
+
+	x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc));
+	x0 = _mm_load_si128(reinterpret_cast<const __m128i*>(k1k2));
+
+	p += 64;
+	n -= 64;
+
+	// four lanes in parallel
+	while (n >= 64)
+	{
+		x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+		x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+		x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+		x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+
+		x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+		x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+		x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+		x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+
+		y5 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 0x00));
+		y6 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 0x10));
+		y7 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 0x20));
+		y8 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 0x30));
+
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+		x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+		x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+		x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+
+		p += 64;
+		n -= 64;
+	}
+
+	// fold the lanes into one
+	x0 = _mm_load_si128(reinterpret_cast<const __m128i*>(k3k4));
+
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+	x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+	x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+	while (n >= 16)
+	{
+		x2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+
+		x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+		x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+		x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+		p += 16;
+		n -= 16;
+	}
+
+	// 128 bits to 64
+	x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+	x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+	x1 = _mm_srli_si128(x1, 8);
+	x1 = _mm_xor_si128(x1, x2);
+
+	x0 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(k5k0));
+
+	x2 = _mm_srli_si128(x1, 4);
+	x1 = _mm_and_si128(x1, x3);
+	x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	// Barrett reduction to 32
+	x0 = _mm_load_si128(reinterpret_cast<const __m128i*>(poly));
+
+	x2 = _mm_and_si128(x1, x3);
+	x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+	x2 = _mm_and_si128(x2, x3);
+	x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+	x1 = _mm_xor_si128(x1, x2);
+
+	return _mm_extract_epi32(x1, 1);
+}
+
+uint32 update_pclmul(uint32 crc, const uint8* p, std::size_t n)
+{
+	if (n >= 64)
+	{
+		std::size_t folded = n & ~static_cast<std::size_t>(15);
+		crc = fold_pclmul(crc, p, folded);
+		p += folded;
+		n -= folded;
+	}
+
+	return update_slice8(crc, p, n);
+}
+
+bool has_pclmul()
+{
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+}
+
+#endif
+
+#ifdef CRC32_ARM
+
+// the ARMv8 CRC32 instructions use the same polynomial, eight bytes at a
+// time
+#ifdef __clang__
+__attribute__((target("crc")))
+#else
+__attribute__((target("+crc")))
+#endif
+uint32 update_armv8(uint32 crc, const uint8* p, std::size_t n)
+{
+	while (n && (reinterpret_cast<std::uintptr_t>(p) & 7))
+	{
+		crc = __crc32b(crc, *p++);
+		--n;
+	}
+
+	while (n >= 8)
+	{
+		crc = __crc32d(crc, *reinterpret_cast<const uint64_t*>(p));
+		p += 8;
+		n -= 8;
+	}
+
+	while (n--)
+	{
+		crc = __crc32b(crc, *p++);
+	}
+
+	return crc;
+}
+
+bool has_armv8_crc()
+{
+#if defined(__ARM_FEATURE_CRC32) || (defined(__APPLE__) && defined(__MACH__))
+	return true;
+#elif defined(__linux__)
+	return getauxval(AT_HWCAP) & HWCAP_CRC32;
+#else
+	return false;
+#endif
+}
+
+#endif
+
+// polynomials mod the CRC polynomial, reflected: x^0 is the top bit
+uint32 multiply(uint32 a, uint32 b)
+{
+	uint32 m = 1U << 31;
+	uint32 product = 0;
+	for (;;)
+	{
+		if (a & m)
+		{
+			product ^= b;
+			if ((a & (m - 1)) == 0)
+				break;
+		}
+		m >>= 1;
+		b = (b & 1) ? (b >> 1) ^ kPolynomial : b >> 1;
+	}
+
+	return product;
+}
+
+uint32 power(uint32 base, uint64_t n)
+{
+	uint32 result = 1U << 31;
+	while (n)
+	{
+		if (n & 1)
+			result = multiply(result, base);
+		base = multiply(base, base);
+		n >>= 1;
+	}
+
+	return result;
+}
+
+// x^8
+const uint32 kXToThe8 = 1U << (31 - 8);
+
+typedef uint32 (*update_function)(uint32, const uint8*, std::size_t);
+
+struct Implementation
+{
+	update_function update;
+	const char* name;
+};
+
+Implementation pick_implementation()
+{
+#ifdef CRC32_X86
+	if (has_pclmul())
+	{
+		return { update_pclmul, "pclmul" };
+	}
+#endif
+#ifdef CRC32_ARM
+	if (has_armv8_crc())
+	{
+		return { update_armv8, "armv8-crc" };
+	}
+#endif
+
+	return { update_slice16, "slice-by-16" };
+}
+
+const Implementation& implementation()
+{
+	static const Implementation implementation = pick_implementation();
+	return implementation;
+}
+
+}
+
+uint32 CRC32::Update(uint32 state, const uint8* data, std::size_t size)
+{
+	return implementation().update(state, data, size);
+}
+
+uint32 CRC32::Shift(uint32 state, uint64_t bytes)
+{
+	return multiply(power(kXToThe8, bytes), state);
+}
+
+const char* CRC32::Engine()
+{
+	return implementation().name;
+}
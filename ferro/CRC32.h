@@ -0,0 +1,59 @@
+/* CRC32.h
+
+   Copyright (C) 2026 by Gregory Smith
+   
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+   
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+   
+   This license is contained in the file "COPYING", which is included
+   with this source code; it is available online at
+   http://www.gnu.org/licenses/gpl.html
+   
+*/
+
+#ifndef CRC32_H
+#define CRC32_H
+
+#include "ferro/cstypes.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace marathon
+{
+	// the zip/ethernet CRC-32 (same results as boost::crc_32_type), using
+	// carry-less multiply or CRC instructions when the CPU has them
+	class CRC32
+	{
+	public:
+		void process_bytes(const void* data, std::size_t size) { state_ = Update(state_, static_cast<const uint8*>(data), size); }
+		uint32 checksum() const { return ~state_; }
+		void reset() { state_ = kInitialState; }
+
+		// state is the raw register: start with kInitialState, and
+		// invert it to get the checksum
+		static uint32 Update(uint32 state, const uint8* data, std::size_t size);
+
+		// the state after bytes more zero bytes; with this a checksum can
+		// be patched when part of a file changes, without rereading the
+		// rest of it
+		static uint32 Shift(uint32 state, uint64_t bytes);
+
+		// which implementation Update ended up with
+		static const char* Engine();
+
+		static const uint32 kInitialState = 0xffffffff;
+
+	private:
+		uint32 state_ = kInitialState;
+	};
+}
+
+#endif
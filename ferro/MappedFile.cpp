@@ -0,0 +1,118 @@
+/* MappedFile.cpp
+
+   Copyright (C) 2026 by Gregory Smith
+   
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+   
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+   
+   This license is contained in the file "COPYING", which is included
+   with this source code; it is available online at
+   http://www.gnu.org/licenses/gpl.html
+   
+*/
+
+#include "ferro/MappedFile.h"
+
+#include <ios>
+
+#ifdef __WIN32__
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace marathon;
+
+#ifdef __WIN32__
+
+MappedFile::MappedFile(const std::filesystem::path& path) : data_(nullptr), size_(0), file_(INVALID_HANDLE_VALUE), mapping_(nullptr)
+{
+	file_ = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file_ == INVALID_HANDLE_VALUE)
+	{
+		throw std::ios_base::failure("could not open " + path.string());
+	}
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file_, &size))
+	{
+		CloseHandle(file_);
+		throw std::ios_base::failure("could not stat " + path.string());
+	}
+	size_ = size.QuadPart;
+
+	// empty files can't be mapped
+	if (size_)
+	{
+		mapping_ = CreateFileMappingW(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping_)
+		{
+			data_ = static_cast<const uint8*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+		}
+
+		if (!data_)
+		{
+			if (mapping_) CloseHandle(mapping_);
+			CloseHandle(file_);
+			throw std::ios_base::failure("could not map " + path.string());
+		}
+	}
+}
+
+MappedFile::~MappedFile()
+{
+	if (data_) UnmapViewOfFile(data_);
+	if (mapping_) CloseHandle(mapping_);
+	CloseHandle(file_);
+}
+
+#else
+
+MappedFile::MappedFile(const std::filesystem::path& path) : data_(nullptr), size_(0)
+{
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		throw std::ios_base::failure("could not open " + path.string());
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) < 0)
+	{
+		close(fd);
+		throw std::ios_base::failure("could not stat " + path.string());
+	}
+	size_ = st.st_size;
+
+	// empty files can't be mapped
+	if (size_)
+	{
+		void* p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (p == MAP_FAILED)
+		{
+			close(fd);
+			throw std::ios_base::failure("could not map " + path.string());
+		}
+		data_ = static_cast<const uint8*>(p);
+	}
+
+	// the mapping stays valid after the descriptor is closed
+	close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+	if (data_) munmap(const_cast<uint8*>(data_), size_);
+}
+
+#endif
@@ -0,0 +1,57 @@
+/* MappedFile.h
+
+   Copyright (C) 2026 by Gregory Smith
+   
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+   
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+   
+   This license is contained in the file "COPYING", which is included
+   with this source code; it is available online at
+   http://www.gnu.org/licenses/gpl.html
+   
+*/
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include "ferro/cstypes.h"
+
+#include <cstddef>
+#include <filesystem>
+
+namespace marathon
+{
+	// read-only view of an entire file; pages are only read from
+	// disk when they are touched
+	class MappedFile
+	{
+	public:
+		// throws std::ios_base::failure if the file can't be mapped
+		explicit MappedFile(const std::filesystem::path& path);
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		const uint8* data() const { return data_; }
+		std::size_t size() const { return size_; }
+
+	private:
+		const uint8* data_;
+		std::size_t size_;
+
+#ifdef __WIN32__
+		void* file_;
+		void* mapping_;
+#endif
+	};
+}
+
+#endif
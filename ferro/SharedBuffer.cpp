@@ -0,0 +1,86 @@
+/* SharedBuffer.cpp
+
+   Copyright (C) 2026 by Gregory Smith
+   
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+   
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+   
+   This license is contained in the file "COPYING", which is included
+   with this source code; it is available online at
+   http://www.gnu.org/licenses/gpl.html
+   
+*/
+
+#include "ferro/SharedBuffer.h"
+#include "ferro/CRC32.h"
+
+#include <algorithm>
+
+using namespace marathon;
+
+SharedBuffer::SharedBuffer(std::vector<uint8>&& data)
+{
+	auto v = std::make_shared<const std::vector<uint8> >(std::move(data));
+	owner_ = v;
+	data_ = v->data();
+	size_ = v->size();
+	vector_ = v;
+}
+
+SharedBuffer& SharedBuffer::operator=(const SharedBuffer& other)
+{
+	owner_ = other.owner_;
+	data_ = other.data_;
+	size_ = other.size_;
+	std::atomic_store(&vector_, std::atomic_load(&other.vector_));
+	return *this;
+}
+
+const std::vector<uint8>& SharedBuffer::vector() const
+{
+	auto vector = std::atomic_load(&vector_);
+	if (!vector)
+	{
+		// if another thread gets there first, use its copy
+		std::shared_ptr<const std::vector<uint8> > expected;
+		vector = std::make_shared<const std::vector<uint8> >(data_, data_ + size_);
+		if (!std::atomic_compare_exchange_strong(&vector_, &expected, vector))
+		{
+			vector = expected;
+		}
+	}
+
+	return *vector;
+}
+
+SharedBuffer SharedBufferCache::Intern(const SharedBuffer& buffer)
+{
+	CRC32 crc;
+	crc.process_bytes(buffer.data(), buffer.size());
+	uint64_t key = (static_cast<uint64_t>(buffer.size()) << 32) | crc.checksum();
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	auto range = buffers_.equal_range(key);
+	for (auto it = range.first; it != range.second; ++it)
+	{
+		if (std::equal(buffer.begin(), buffer.end(), it->second.begin()))
+		{
+			return it->second;
+		}
+	}
+
+	buffers_.insert(std::make_pair(key, buffer));
+	return buffer;
+}
+
+SharedBuffer SharedBufferCache::Intern(std::vector<uint8>&& data)
+{
+	return Intern(SharedBuffer(std::move(data)));
+}
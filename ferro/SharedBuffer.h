@@ -0,0 +1,89 @@
+/* SharedBuffer.h
+
+   Copyright (C) 2026 by Gregory Smith
+   
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+   
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+   
+   This license is contained in the file "COPYING", which is included
+   with this source code; it is available online at
+   http://www.gnu.org/licenses/gpl.html
+   
+*/
+
+#ifndef SHAREDBUFFER_H
+#define SHAREDBUFFER_H
+
+#include "ferro/cstypes.h"
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace marathon
+{
+	// immutable, reference counted bytes; copying one, or taking a
+	// slice of one, never copies the data
+	class SharedBuffer
+	{
+	public:
+		SharedBuffer() : data_(nullptr), size_(0) { }
+		SharedBuffer(const std::vector<uint8>& data) : SharedBuffer(std::vector<uint8>(data)) { }
+		SharedBuffer(std::vector<uint8>&& data);
+
+		// memory kept alive by owner, e.g. a MappedFile
+		SharedBuffer(const std::shared_ptr<const void>& owner, const uint8* data, std::size_t size) : owner_(owner), data_(data), size_(size) { }
+
+		// part of another buffer
+		SharedBuffer(const SharedBuffer& parent, std::size_t offset, std::size_t size) : owner_(parent.owner_), data_(parent.data_ + offset), size_(size) { }
+
+		SharedBuffer(const SharedBuffer& other) : owner_(other.owner_), data_(other.data_), size_(other.size_), vector_(std::atomic_load(&other.vector_)) { }
+		SharedBuffer(SharedBuffer&&) = default;
+		SharedBuffer& operator=(const SharedBuffer& other);
+		SharedBuffer& operator=(SharedBuffer&&) = default;
+
+		const uint8* data() const { return data_; }
+		std::size_t size() const { return size_; }
+		bool empty() const { return size_ == 0; }
+
+		const uint8* begin() const { return data_; }
+		const uint8* end() const { return data_ + size_; }
+
+		// slices are copied out the first time they're asked for; safe
+		// to call from several threads at once
+		const std::vector<uint8>& vector() const;
+
+	private:
+		std::shared_ptr<const void> owner_;
+		const uint8* data_;
+		std::size_t size_;
+
+		// only touched with std::atomic_load/atomic_compare_exchange
+		mutable std::shared_ptr<const std::vector<uint8> > vector_;
+	};
+
+	// hands back the first buffer it saw with the same contents, so
+	// identical chunks from different files share one copy; safe to
+	// use from several threads
+	class SharedBufferCache
+	{
+	public:
+		SharedBuffer Intern(const SharedBuffer& buffer);
+		SharedBuffer Intern(std::vector<uint8>&& data);
+
+	private:
+		std::mutex mutex_;
+		std::unordered_multimap<uint64_t, SharedBuffer> buffers_;
+	};
+}
+
+#endif
@@ -509,6 +509,7 @@ bool TerminalText::Compile(std::istream& stream, int expected_id)
 	text_.clear();
 	groupings_.clear();
 	font_changes_.clear();
+	flags_ = 0;
 	
 	int terminal_id = 0;
 
@@ -38,7 +38,7 @@ const std::vector<uint8>& Wad::GetChunk(uint32 tag) const
 {
 	if (chunks_.count(tag))
 	{
-		return chunks_.find(tag)->second;
+		return chunks_.find(tag)->second.vector();
 	}
 	else
 	{
@@ -47,6 +47,19 @@ const std::vector<uint8>& Wad::GetChunk(uint32 tag) const
 	}
 }
 
+const SharedBuffer& Wad::GetSharedChunk(uint32 tag) const
+{
+	if (chunks_.count(tag))
+	{
+		return chunks_.find(tag)->second;
+	}
+	else
+	{
+		static SharedBuffer empty_buffer;
+		return empty_buffer;
+	}
+}
+
 std::vector<uint32> Wad::GetTags() const
 {
 	std::vector<uint32> v;
@@ -76,15 +89,45 @@ void Wad::Load(std::istream& s, int16 entry_header_length)
 		header.Load(header_stream, entry_header_length);
 
 		// load the tag data
-		std::vector<uint8>& tag_data = chunks_[header.tag];
-		tag_data.resize(header.length);
+		std::vector<uint8> tag_data(header.length);
 		s.read(reinterpret_cast<char *>(&tag_data.front()), tag_data.size());
+		chunks_[header.tag] = SharedBuffer(std::move(tag_data));
 		if (header.next_offset) 
 			s.seekg(start + static_cast<std::streamoff>(header.next_offset));
 
 	} while (header.next_offset);
 }
 
+void Wad::Load(const SharedBuffer& data, std::size_t offset, int16 entry_header_length)
+{
+	std::size_t start = offset;
+	std::size_t end = data.size();
+
+	EntryHeader header;
+	do {
+		if (offset + entry_header_length > end)
+			throw std::ios_base::failure("wad entry header out of range");
+
+		AIStreamBE header_stream(data.data() + offset, entry_header_length);
+		header.Load(header_stream, entry_header_length);
+
+		offset += entry_header_length;
+		if (header.length < 0 || offset + header.length > end)
+			throw std::ios_base::failure("wad entry out of range");
+
+		// only remember where the tag data is
+		chunks_[header.tag] = SharedBuffer(data, offset, header.length);
+
+		if (header.next_offset)
+		{
+			if (header.next_offset < 0 || start + header.next_offset < offset + header.length)
+				throw std::ios_base::failure("wad entry offsets go backwards");
+			
+			offset = start + header.next_offset;
+		}
+	} while (header.next_offset);
+}
+
 int32 Wad::GetSize() const
 {
 	int32 size = 0;
@@ -151,7 +194,7 @@ void Wad::Save(crc_ostream& s) const
 
 	for (std::vector<uint32>::const_iterator it = tags.begin(); it != tags.end(); ++it)
 	{
-		const std::vector<uint8>& chunk = chunks_.find(*it)->second;
+		const SharedBuffer& chunk = chunks_.find(*it)->second;
 
 		EntryHeader header;
 		header.tag = *it;
@@ -162,16 +205,16 @@ void Wad::Save(crc_ostream& s) const
 			header.next_offset = offset + kEntryHeaderSize + header.length;
 		header.offset = 0;
 
-		std::vector<uint8> header_buffer(kEntryHeaderSize);
-		AOStreamBE header_stream(&header_buffer[0], header_buffer.size());
+		uint8 header_buffer[kEntryHeaderSize];
+		AOStreamBE header_stream(header_buffer, kEntryHeaderSize);
 		header.Save(header_stream);
-		s.write(reinterpret_cast<const char *>(&header_buffer[0]), header_buffer.size());
-		s.write(reinterpret_cast<const char *>(&chunk[0]), chunk.size());
+		s.write(header_buffer, kEntryHeaderSize);
+		s.write(chunk.data(), chunk.size());
 		offset += header.length + kEntryHeaderSize;
 	}
 }
 
-void Wad::EntryHeader::Load(AIStream& s, int16 entry_header_length)
+void Wad::EntryHeader::Load(AIStreamBE& s, int16 entry_header_length)
 {
 	s >> tag;
 	s >> next_offset;
@@ -184,7 +227,7 @@ void Wad::EntryHeader::Load(AIStream& s, int16 entry_header_length)
 
 }
 
-void Wad::EntryHeader::Save(AOStream& s)
+void Wad::EntryHeader::Save(AOStreamBE& s)
 {
 	s << tag;
 	s << next_offset;
@@ -194,7 +237,7 @@ void Wad::EntryHeader::Save(AOStream& s)
 
 std::ostream& marathon::operator<<(std::ostream& s, const Wad& w)
 {
-	for (std::map<uint32, std::vector<uint8> >::const_iterator it = w.chunks_.begin(); it != w.chunks_.end(); ++it)
+	for (Wad::chunk_map::const_iterator it = w.chunks_.begin(); it != w.chunks_.end(); ++it)
 	{
 		s << std::string(reinterpret_cast<const char*>(&it->first), 4) << std::endl;
 	}
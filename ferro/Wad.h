@@ -22,14 +22,17 @@
 #define WAD_H
 
 #include "ferro/cstypes.h"
+#include "ferro/SharedBuffer.h"
 
+#include <cstddef>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
-class AIStream;
-class AOStream;
+class AIStreamBE;
+class AOStreamBE;
 
 namespace marathon
 {
@@ -50,9 +53,12 @@ namespace marathon
 		void Load(std::istream& stream);
 		void Load(std::istream& stream, int16 entry_header_length);
 		
-		void AddChunk(uint32 tag, const std::vector<uint8>& data) { chunks_[tag] = data; }
+		void AddChunk(uint32 tag, const std::vector<uint8>& data) { chunks_[tag] = SharedBuffer(data); }
+		void AddChunk(uint32 tag, std::vector<uint8>&& data) { chunks_[tag] = SharedBuffer(std::move(data)); }
+		void AddChunk(uint32 tag, const SharedBuffer& data) { chunks_[tag] = data; }
 		bool HasChunk(uint32 tag) const;
 		const std::vector<uint8>& GetChunk(uint32 tag) const;
+		const SharedBuffer& GetSharedChunk(uint32 tag) const;
 		void RemoveChunk(uint32 tag) { chunks_.erase(tag); }
 
 		std::vector<uint32> GetTags() const;
@@ -62,7 +68,11 @@ namespace marathon
 		void Save(crc_ostream& s) const;
 		
 	private:
-		typedef std::map<uint32, std::vector<uint8> > chunk_map;
+		// chunks loaded from memory are slices of data, and aren't
+		// copied out until somebody asks for them
+		void Load(const SharedBuffer& data, std::size_t offset, int16 entry_header_length);
+
+		typedef std::map<uint32, SharedBuffer> chunk_map;
 		chunk_map chunks_;
 		
 		struct EntryHeader
@@ -72,8 +82,8 @@ namespace marathon
 			int32 length;
 			int32 offset;
 			
-			void Load(AIStream& stream, int16 entry_header_length);
-			void Save(AOStream& stream);
+			void Load(AIStreamBE& stream, int16 entry_header_length);
+			void Save(AOStreamBE& stream);
 		};
 	};
 
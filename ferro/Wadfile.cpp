@@ -19,17 +19,27 @@
 */
 
 #include "ferro/AStream.h"
+#include "ferro/MappedFile.h"
 #include "ferro/Wadfile.h"
 
+#include <algorithm>
 #include <fstream>
+#include <sstream>
 #include <string.h>
 
 using namespace marathon;
 
-bool Wadfile::Load(std::istream& stream)
+void Wadfile::Clear()
 {
 	directory_.clear();
 	directory_data_.clear();
+	wads_.clear();
+	data_ = SharedBuffer();
+}
+
+bool Wadfile::Load(std::istream& stream)
+{
+	Clear();
 	
 	try {
 		auto start = stream.tellg();
@@ -134,6 +144,7 @@ bool Wadfile::Save(std::ostream& stream)
 			newHeader.Save(crc_stream);
 		}
 		crc_stream.seekp(end);
+		crc_stream.flush();
 	}
 	catch (std::ios_base::failure e)
 	{
@@ -155,8 +166,447 @@ bool Wadfile::Save(const std::filesystem::path& path)
 	return Save(stream);
 }
 
+bool Wadfile::Map(const std::filesystem::path& path, std::streamoff offset, std::streamsize length)
+{
+	Clear();
+
+	try {
+		auto file = std::make_shared<MappedFile>(path);
+
+		std::size_t start = offset;
+		std::size_t end = (length < 0) ? file->size() : start + length;
+		if (offset < 0 || end > file->size() || end < start)
+			return false;
+
+		data_ = SharedBuffer(file, file->data() + start, end - start);
+		LoadDirectory();
+	}
+	catch (const std::ios_base::failure&)
+	{
+		Clear();
+		return false;
+	}
+	catch (const AStream::failure&)
+	{
+		Clear();
+		return false;
+	}
+
+	return true;
+}
+
+bool Wadfile::Load(std::istream& stream, IntegrityReport& report)
+{
+	Clear();
+	report = IntegrityReport();
+
+	try {
+		auto start = stream.tellg();
+		stream.seekg(0, std::ios::end);
+		std::streamoff length = stream.tellg() - start;
+		stream.seekg(start);
+
+		if (!stream || length < Header::kSize)
+			return false;
+
+		std::vector<uint8> data(length);
+
+		// one pass: each block is checksummed as soon as it's read
+		const std::size_t kBlockSize = 1024 * 1024;
+		uint32 state = CRC32::kInitialState;
+		for (std::size_t pos = 0; pos < data.size(); pos += kBlockSize)
+		{
+			uint8* block = data.data() + pos;
+			std::size_t block_size = std::min(kBlockSize, data.size() - pos);
+			stream.read(reinterpret_cast<char*>(block), block_size);
+			if (stream.gcount() != static_cast<std::streamsize>(block_size))
+				return false;
+
+			if (pos == 0)
+			{
+				// the checksum is computed with the checksum field zeroed
+				uint8* checksum = block + Header::kChecksumOffset;
+				uint8 saved[4];
+				std::copy(checksum, checksum + 4, saved);
+				std::fill_n(checksum, 4, 0);
+				state = CRC32::Update(state, block, block_size);
+				std::copy(saved, saved + 4, checksum);
+			}
+			else
+			{
+				state = CRC32::Update(state, block, block_size);
+			}
+		}
+		report.computed_checksum = ~state;
+
+		data_ = SharedBuffer(std::move(data));
+		LoadDirectory();
+	}
+	catch (const std::ios_base::failure&)
+	{
+		Clear();
+		return false;
+	}
+	catch (const AStream::failure&)
+	{
+		Clear();
+		return false;
+	}
+
+	report.header_ok = true;
+	report.stored_checksum = header_.checksum;
+	Check(report);
+
+	return report.ok();
+}
+
+bool Wadfile::Load(const std::filesystem::path& path, IntegrityReport& report)
+{
+	std::ifstream stream{path, std::ios_base::in | std::ios_base::binary};
+	return Load(stream, report);
+}
+
+void Wadfile::LoadDirectory()
+{
+	if (data_.size() < Header::kSize)
+		throw std::ios_base::failure("wadfile too short");
+
+	AIStreamBE header_stream(data_.data(), Header::kSize);
+	header_.Load(header_stream);
+
+	if (header_.directory_offset < Header::kSize || static_cast<std::size_t>(header_.directory_offset) > data_.size())
+		throw std::ios_base::failure("directory out of range");
+
+	AIStreamBE stream(data_.data() + header_.directory_offset, data_.size() - header_.directory_offset);
+	for (int i = 0; i < header_.wad_count; ++i)
+	{
+		DirectoryEntry entry;
+		entry.Load(stream, header_.directory_entry_base_size, i);
+		directory_[entry.index] = entry;
+		if (header_.application_specific_directory_data_size == DirectoryData::kSize)
+		{
+			directory_data_[entry.index].Load(stream);
+		}
+		else
+		{
+			stream.ignore(header_.application_specific_directory_data_size);
+		}
+	}
+}
+
+void Wadfile::Check(IntegrityReport& report)
+{
+	for (const auto& [index, entry] : directory_)
+	{
+		IntegrityReport::Entry result;
+		result.index = index;
+		result.offset = entry.offset;
+		result.size = entry.size;
+		result.in_bounds = entry.offset >= Header::kSize &&
+			entry.size >= 0 &&
+			static_cast<int64_t>(entry.offset) + entry.size <= header_.directory_offset;
+
+		if (result.in_bounds && entry.size == 0)
+		{
+			result.parsed = true;
+		}
+		else if (result.in_bounds)
+		{
+			// parse the wad within its own entry, so chunks that run
+			// into the next one are caught too
+			try {
+				Wad wad;
+				wad.Load(SharedBuffer(data_, 0, entry.offset + entry.size), entry.offset, header_.entry_header_size);
+				wads_[index] = std::move(wad);
+				result.parsed = true;
+			}
+			catch (const std::ios_base::failure&)
+			{
+			}
+			catch (const AStream::failure&)
+			{
+			}
+		}
+
+		report.entries.push_back(result);
+	}
+
+	for (auto a = report.entries.begin(); a != report.entries.end(); ++a)
+	{
+		if (!a->in_bounds || a->size == 0)
+			continue;
+
+		for (auto b = a + 1; b != report.entries.end(); ++b)
+		{
+			if (!b->in_bounds || b->size == 0)
+				continue;
+
+			if (a->offset < b->offset + b->size && b->offset < a->offset + a->size)
+			{
+				report.overlaps.push_back(std::make_pair(a->index, b->index));
+			}
+		}
+	}
+}
+
+bool Wadfile::Update(const std::filesystem::path& path, int16 index, const Wad& wad, const std::string& level_name)
+{
+	try {
+		std::fstream file{path, std::ios_base::in | std::ios_base::out | std::ios_base::binary};
+		file.exceptions(std::ios_base::failbit | std::ios_base::badbit | std::ios_base::eofbit);
+
+		file.seekg(0, std::ios_base::end);
+		std::streamoff file_size = file.tellg();
+		file.seekg(0);
+
+		uint8 old_header_data[Header::kSize];
+		file.read(reinterpret_cast<char*>(old_header_data), Header::kSize);
+
+		Header header;
+		AIStreamBE header_stream(old_header_data, Header::kSize);
+		header.Load(header_stream);
+
+		// only the layout Save writes: directory last. Anything after it
+		// is left over from an update that never got to the header
+		int16 application_size = header.application_specific_directory_data_size;
+		std::streamoff entry_size = DirectoryEntry::kSize + application_size;
+		std::streamoff old_end = header.directory_offset + header.wad_count * entry_size;
+		if (header.version < Header::WADFILE_HAS_INFINITY_STUFF ||
+			header.entry_header_size != Wad::kEntryHeaderSize ||
+			header.directory_entry_base_size != DirectoryEntry::kSize ||
+			(application_size != 0 && application_size != DirectoryData::kSize) ||
+			header.directory_offset < Header::kSize ||
+			old_end > file_size)
+		{
+			return false;
+		}
+
+		std::vector<uint8> old_directory(old_end - header.directory_offset);
+		file.seekg(header.directory_offset);
+		file.read(reinterpret_cast<char*>(old_directory.data()), old_directory.size());
+
+		std::vector<std::pair<DirectoryEntry, DirectoryData> > directory(header.wad_count);
+		AIStreamBE directory_stream(old_directory.data(), old_directory.size());
+		for (int i = 0; i < header.wad_count; ++i)
+		{
+			directory[i].first.Load(directory_stream, DirectoryEntry::kSize, i);
+			if (application_size)
+			{
+				directory[i].second.Load(directory_stream);
+			}
+		}
+
+		std::ostringstream wad_stream;
+		{
+			crc_ostream s(wad_stream);
+			wad.Save(s);
+			s.flush();
+		}
+		std::string wad_data = wad_stream.str();
+		if (wad_data.empty())
+			return false;
+
+		auto entry = std::find_if(directory.begin(), directory.end(), [index](const std::pair<DirectoryEntry, DirectoryData>& e) { return e.first.index == index; });
+		if (entry == directory.end())
+		{
+			directory.emplace_back();
+			entry = directory.end() - 1;
+			entry->first.index = index;
+			++header.wad_count;
+		}
+
+		// the old wad and directory stay where they are, so the file is
+		// whole until the header points past them
+		entry->first.offset = old_end;
+		entry->first.size = wad_data.size();
+		header.directory_offset = old_end + wad_data.size();
+
+		entry->second = DirectoryData::FromWad(wad);
+		if (level_name.size())
+		{
+			strncpy(entry->second.level_name, level_name.c_str(), MapInfo::kLevelNameLength);
+			entry->second.level_name[MapInfo::kLevelNameLength - 1] = '\0';
+		}
+
+		std::ostringstream directory_out;
+		{
+			crc_ostream s(directory_out);
+			for (const auto& [directory_entry, directory_data] : directory)
+			{
+				directory_entry.Save(s);
+				if (application_size)
+				{
+					directory_data.Save(s);
+				}
+			}
+			s.flush();
+		}
+		std::string new_directory = directory_out.str();
+
+		uint32 old_checksum = header.checksum;
+		header.checksum = 0;
+
+		if (old_checksum)
+		{
+			// the CRC is linear: xor in the header's change, shifted past
+			// the rest of the old file, then carry on with the new tail
+			std::ostringstream header_out;
+			{
+				crc_ostream s(header_out);
+				header.Save(s);
+				s.flush();
+			}
+			std::string new_header = header_out.str();
+
+			std::fill_n(old_header_data + Header::kChecksumOffset, 4, 0);
+			uint8 difference[Header::kSize];
+			for (std::size_t i = 0; i < Header::kSize; ++i)
+			{
+				difference[i] = old_header_data[i] ^ static_cast<uint8>(new_header[i]);
+			}
+
+			uint32 state = ~old_checksum;
+			state ^= CRC32::Shift(CRC32::Update(0, difference, Header::kSize), old_end - Header::kSize);
+			state = CRC32::Update(state, reinterpret_cast<const uint8*>(wad_data.data()), wad_data.size());
+			state = CRC32::Update(state, reinterpret_cast<const uint8*>(new_directory.data()), new_directory.size());
+			header.checksum = ~state;
+		}
+
+		// wad, then directory, and only once both are out the header
+		// that points at them
+		file.seekp(old_end);
+		file.write(wad_data.data(), wad_data.size());
+		file.write(new_directory.data(), new_directory.size());
+		file.flush();
+
+		std::ostringstream final_header;
+		{
+			crc_ostream s(final_header);
+			header.Save(s);
+			s.flush();
+		}
+		file.seekp(0);
+		file.write(final_header.str().data(), Header::kSize);
+		file.flush();
+		file.close();
+
+		// the update is done; dropping what an interrupted one left
+		// behind only matters to the checksum, so a failure is harmless
+		std::streamoff new_end = header.directory_offset + new_directory.size();
+		if (file_size > new_end)
+		{
+			std::error_code error;
+			std::filesystem::resize_file(path, new_end, error);
+		}
+	}
+	catch (const std::ios_base::failure&)
+	{
+		return false;
+	}
+	catch (const AStream::failure&)
+	{
+		return false;
+	}
+
+	return true;
+}
+
+bool Wadfile::IntegrityReport::ok() const
+{
+	if (!header_ok || !checksum_ok() || overlaps.size())
+		return false;
+
+	for (const auto& entry : entries)
+	{
+		if (!entry.in_bounds || !entry.parsed)
+			return false;
+	}
+
+	return true;
+}
+
+bool Wadfile::IsHeader(const uint8* data, std::size_t size, std::size_t file_size)
+{
+	if (size < Header::kSize)
+		return false;
+
+	Header header;
+	AIStreamBE stream(data, Header::kSize);
+	header.Load(stream);
+
+	if (header.version < Header::PRE_ENTRY_POINT_WADFILE_VERSION ||
+		header.version > Header::CURRENT_WADFILE_VERSION ||
+		header.data_version < 0 ||
+		header.wad_count < 0 ||
+		header.directory_offset < Header::kSize ||
+		header.application_specific_directory_data_size < 0)
+	{
+		return false;
+	}
+
+	if (header.entry_header_size != Wad::kEntryHeaderSize &&
+		header.entry_header_size != Wad::kEntryHeaderOldSize)
+	{
+		return false;
+	}
+
+	if (header.directory_entry_base_size != DirectoryEntry::kSize &&
+		header.directory_entry_base_size != DirectoryEntry::kOldSize)
+	{
+		return false;
+	}
+
+	if (file_size)
+	{
+		auto directory_size = static_cast<std::size_t>(header.wad_count) * (header.directory_entry_base_size + header.application_specific_directory_data_size);
+		if (static_cast<std::size_t>(header.directory_offset) + directory_size > file_size)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool Wadfile::VerifyChecksum() const
+{
+	if (data_.empty())
+		return false;
+
+	if (header_.checksum == 0)
+		return true;
+
+	// the checksum is computed with the checksum field zeroed
+	const uint8* p = data_.data();
+	const uint8 zero[4] = { };
+
+	uint32 state = CRC32::kInitialState;
+	state = CRC32::Update(state, p, Header::kChecksumOffset);
+	state = CRC32::Update(state, zero, sizeof(zero));
+	state = CRC32::Update(state, p + Header::kChecksumOffset + sizeof(zero), data_.size() - Header::kChecksumOffset - sizeof(zero));
+
+	return ~state == header_.checksum;
+}
+
 const Wad& Wadfile::GetWad(int16 index) const
 {
+	std::lock_guard<std::mutex> lock(wads_mutex_.mutex);
+	if (!data_.empty() && !wads_.count(index) && directory_.count(index))
+	{
+		const DirectoryEntry& entry = directory_.at(index);
+		if (entry.offset < Header::kSize || static_cast<std::size_t>(entry.offset) > data_.size())
+			throw std::ios_base::failure("wad offset out of range");
+
+		try {
+			wads_[index].Load(data_, entry.offset, header_.entry_header_size);
+		}
+		catch (...)
+		{
+			wads_.erase(index);
+			throw;
+		}
+	}
+
 	return wads_.at(index);
 }
 
@@ -168,6 +618,14 @@ void Wadfile::SetWad(int16 index, const Wad& wad)
 	UpdateDirectory(index);
 }
 
+void Wadfile::SetWad(int16 index, Wad&& wad)
+{
+	directory_[index].index = index;
+	directory_[index].size = wad.GetSize();
+	wads_[index] = std::move(wad);
+	UpdateDirectory(index);
+}
+
 uint32 Wadfile::GetEntryPointFlags(int16 index)
 {
 	if (directory_.count(index))
@@ -242,7 +700,11 @@ void Wadfile::Header::Load(std::istream& stream)
 	std::vector<uint8> data(kSize);
 	stream.read(reinterpret_cast<char*>(&data[0]), data.size());
 	AIStreamBE s(&data[0], data.size());
-	
+	Load(s);
+}
+
+void Wadfile::Header::Load(AIStreamBE& s)
+{
 	s >> version;
 	s >> data_version;
 	s.read(file_name, kFilenameLength);
@@ -266,8 +728,8 @@ void Wadfile::Header::Load(std::istream& stream)
 
 void Wadfile::Header::Save(crc_ostream& stream)
 {
-	std::vector<uint8> data(kSize);
-	AOStreamBE s(&data[0], data.size());
+	uint8 data[kSize] = { };
+	AOStreamBE s(data, kSize);
 
 	s << version;
 	s << data_version;
@@ -279,17 +741,22 @@ void Wadfile::Header::Save(crc_ostream& stream)
 	s << entry_header_size;
 	s << directory_entry_base_size;
 	s << parent_checksum;
-	std::vector<uint8> padding(2 * 20);
-	s.write(&padding[0], padding.size());
+	// the rest is padding
 
-	stream.write(&data[0], data.size());
+	stream.write(data, kSize);
 }
 
 void Wadfile::UpdateDirectory(int16 index)
 {
 	bool wasLoaded = wads_.count(index);
 
-	const Wad& wad = GetWad(index);
+	directory_data_[index] = DirectoryData::FromWad(GetWad(index));
+
+	if (!wasLoaded) wads_.erase(index);
+}
+
+Wadfile::DirectoryData Wadfile::DirectoryData::FromWad(const Wad& wad)
+{
 	DirectoryData entry;
 	if (wad.HasChunk(MapInfo::kTag))
 	{
@@ -301,9 +768,8 @@ void Wadfile::UpdateDirectory(int16 index)
 		strncpy(entry.level_name, info.level_name().c_str(), MapInfo::kLevelNameLength);
 		entry.level_name[MapInfo::kLevelNameLength - 1] = '\0';
 	}
-	directory_data_[index] = entry;
 
-	if (!wasLoaded) wads_.erase(index);
+	return entry;
 }
 
 void Wadfile::DirectoryEntry::Load(std::istream& stream, int16 directory_entry_base_size, int16 new_index)
@@ -311,7 +777,11 @@ void Wadfile::DirectoryEntry::Load(std::istream& stream, int16 directory_entry_b
 	std::vector<uint8> data(directory_entry_base_size);
 	stream.read(reinterpret_cast<char*>(&data[0]), data.size());
 	AIStreamBE s(&data[0], data.size());
-	
+	Load(s, directory_entry_base_size, new_index);
+}
+
+void Wadfile::DirectoryEntry::Load(AIStreamBE& s, int16 directory_entry_base_size, int16 new_index)
+{
 	s >> offset;
 	s >> size;
 	if (directory_entry_base_size >= kSize)
@@ -325,14 +795,14 @@ void Wadfile::DirectoryEntry::Load(std::istream& stream, int16 directory_entry_b
 
 void Wadfile::DirectoryEntry::Save(crc_ostream& stream) const
 {
-	std::vector<uint8> data(kSize);
-	AOStreamBE s(&data[0], data.size());
+	uint8 data[kSize];
+	AOStreamBE s(data, kSize);
 
 	s << offset;
 	s << size;
 	s << index;
 
-	stream.write(&data[0], data.size());
+	stream.write(data, kSize);
 }
 
 void Wadfile::DirectoryData::Load(std::istream& stream)
@@ -355,25 +825,70 @@ void Wadfile::DirectoryData::Load(std::istream& stream)
 	}
 
 	AIStreamBE s(&data[0], data.size());
+	Load(s);
+}
 
+void Wadfile::DirectoryData::Load(AIStreamBE& s)
+{
 	s >> mission_flags;
 	s >> environment_flags;
 	s >> entry_point_flags;
-	s.read(level_name, MapInfo::kLevelNameLength);
+
+	// broken JUICE merge would write some files 2 bytes short
+	if (s.maxg() - s.tellg() == MapInfo::kLevelNameLength - 2)
+	{
+		s.read(level_name, MapInfo::kLevelNameLength - 2);
+	}
+	else
+	{
+		s.read(level_name, MapInfo::kLevelNameLength);
+	}
 	level_name[MapInfo::kLevelNameLength - 1] = '\0';
 }
 
 void Wadfile::DirectoryData::Save(crc_ostream& stream) const
 {
-	std::vector<uint8> data(kSize);
-	AOStreamBE s(&data[0], data.size());
+	uint8 data[kSize];
+	AOStreamBE s(data, kSize);
 
 	s << mission_flags;
 	s << environment_flags;
 	s << entry_point_flags;
 	s.write(level_name, MapInfo::kLevelNameLength);
 
-	stream.write(&data[0], data.size());
+	stream.write(data, kSize);
+}
+
+crc_ostream& crc_ostream::write(const uint8* s, std::streamsize n)
+{
+	crc_.process_bytes(s, n);
+
+	if (buffer_.size() + n > kBufferSize)
+	{
+		flush();
+	}
+
+	if (n >= static_cast<std::streamsize>(kBufferSize))
+	{
+		stream_.write(reinterpret_cast<const char*>(s), n);
+	}
+	else
+	{
+		buffer_.insert(buffer_.end(), s, s + n);
+	}
+
+	return *this;
+}
+
+crc_ostream& crc_ostream::flush()
+{
+	if (buffer_.size())
+	{
+		stream_.write(reinterpret_cast<const char*>(buffer_.data()), buffer_.size());
+		buffer_.clear();
+	}
+
+	return *this;
 }
 
 std::ostream& marathon::operator<<(std::ostream& s, const Wadfile& w)
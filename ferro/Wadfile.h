@@ -21,6 +21,7 @@
 #ifndef WADFILE_H
 #define WADFILE_H
 
+#include "ferro/CRC32.h"
 #include "ferro/MapInfoChunk.h"
 #include "ferro/Wad.h"
 
@@ -29,11 +30,10 @@
 #include <fstream>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
-#include <boost/crc.hpp>
-
 namespace marathon
 {
 	class crc_ostream;
@@ -48,9 +48,68 @@ namespace marathon
 		bool Load(const std::filesystem::path& path);
 		bool Save(const std::filesystem::path& path);
 
+		// reads only the header and directory from a memory-mapped
+		// file; wads are parsed, and chunks copied, on demand. offset
+		// and length describe where the wadfile lives in the file
+		// (e.g. a MacBinary data fork)
+		bool Map(const std::filesystem::path& path, std::streamoff offset = 0, std::streamsize length = -1);
+
+		// recomputes the CRC of a wadfile read with Map or a checking Load
+		// and compares it with the header; files written without a
+		// checksum (0) always pass. A plain Load keeps no copy of the
+		// file, so a wadfile read that way (or built in memory) fails
+		bool VerifyChecksum() const;
+
+		// whether size bytes (at least the 128 byte header) from the start
+		// of a file look like a wadfile header; without reading anything
+		// else. file_size, if known, must hold the directory
+		static bool IsHeader(const uint8* data, std::size_t size, std::size_t file_size = 0);
+
+		// what a checking Load found wrong with a wadfile
+		struct IntegrityReport
+		{
+			struct Entry
+			{
+				int16 index = 0;
+				int32 offset = 0;
+				int32 size = 0;
+				bool in_bounds = false; // between the header and the directory
+				bool parsed = false; // chunk headers stay inside the entry
+			};
+
+			bool header_ok = false; // header and directory could be read
+			std::vector<Entry> entries;
+			std::vector<std::pair<int16, int16> > overlaps;
+
+			uint32 stored_checksum = 0;
+			uint32 computed_checksum = 0;
+			bool checksum_ok() const { return stored_checksum == 0 || stored_checksum == computed_checksum; }
+
+			bool ok() const;
+		};
+
+		// reads the whole wadfile in one sequential pass, computing the
+		// CRC on the way in, then checks every directory entry; returns
+		// report.ok()
+		bool Load(std::istream& stream, IntegrityReport& report);
+		bool Load(const std::filesystem::path& path, IntegrityReport& report);
+
+		// replaces or adds one wad in the wadfile at path without
+		// rewriting the others: the wad and a new directory are appended,
+		// and the header is written last, so an interrupted update leaves
+		// the old contents readable. The checksum is patched rather than
+		// recomputed, so only the header and the directory are read.
+		// level_name, if given, overrides the map's name in the
+		// directory. Only bare (not MacBinary) wadfiles in the current
+		// format can be updated
+		static bool Update(const std::filesystem::path& path, int16 index, const Wad& wad, const std::string& level_name = std::string());
+
 		bool HasWad(int16 index) { return directory_.count(index); }
+		// parses the wad first, if it was mapped; several threads may
+		// call this at once, but not alongside any non-const method
 		const Wad& GetWad(int16 index) const;
 		void SetWad(int16 index, const Wad& wad);
+		void SetWad(int16 index, Wad&& wad);
 
 		std::vector<int16> GetWadIndexes() const;
 		std::vector<int16> GetEntryPointIndexes(uint32 entry_point_flags = ~0);
@@ -71,12 +130,31 @@ namespace marathon
 		uint32 parent_checksum() { return header_.parent_checksum; }
 
 	private:
-		std::map<int16, Wad> wads_;
+		mutable std::map<int16, Wad> wads_;
+
+		// guards the lazy parse in GetWad; copies get a mutex of their own
+		struct WadsMutex
+		{
+			std::mutex mutex;
+			WadsMutex() { }
+			WadsMutex(const WadsMutex&) { }
+			WadsMutex& operator=(const WadsMutex&) { return *this; }
+		};
+		mutable WadsMutex wads_mutex_;
+
+		// the whole wadfile, when it was read with Map or a checking
+		// Load; wads are parsed from it on demand
+		SharedBuffer data_;
+
+		void Clear();
+		void LoadDirectory();
+		void Check(IntegrityReport& report);
 
 		struct Header
 		{
 			static const int kFilenameLength = 64;
 			enum { kSize = 128 };
+			enum { kChecksumOffset = 4 + kFilenameLength };
 			enum { 
 				PRE_ENTRY_POINT_WADFILE_VERSION = 0,
 				WADFILE_HAS_DIRECTORY_ENTRY = 1,
@@ -105,6 +183,7 @@ namespace marathon
 			uint32 parent_checksum;
 
 			void Load(std::istream&);
+			void Load(AIStreamBE&);
 			void Save(crc_ostream&);
 
 			// int16 unused[20];
@@ -121,6 +200,7 @@ namespace marathon
 			int16 index;
 
 			void Load(std::istream&, int16 directory_entry_base_size, int16 index);
+			void Load(AIStreamBE&, int16 directory_entry_base_size, int16 index);
 			void Save(crc_ostream&) const;
 		};
 		friend std::ostream& operator<<(std::ostream&, const DirectoryEntry&);
@@ -141,27 +221,36 @@ namespace marathon
 			DirectoryData() : mission_flags(0), environment_flags(0), entry_point_flags(0) { std::fill_n(level_name, MapInfo::kLevelNameLength, '\0'); }
 
 			void Load(std::istream&);
+			void Load(AIStreamBE&);
 			void Save(crc_ostream&) const;
+
+			static DirectoryData FromWad(const Wad& wad);
 		};
 		std::map<int16, DirectoryData> directory_data_;
 	};
 
+	// small writes (headers, directory entries) are gathered into one
+	// buffer; anything bigger than the buffer goes straight through
 	class crc_ostream
 	{
 	public:
-		crc_ostream(std::ostream& stream) : stream_(stream) { }
+		static const std::size_t kBufferSize = 256 * 1024;
+
+		crc_ostream(std::ostream& stream) : stream_(stream) { buffer_.reserve(kBufferSize); }
 
-		std::streampos tellp() const { return stream_.tellp(); }
-		crc_ostream& seekp(std::streampos pos) { stream_.seekp(pos); return *this; }
-		crc_ostream& write(const char *s, std::streamsize n) { stream_.write(s, n); crc_.process_bytes(s, n); return *this; }
-		crc_ostream& write(uint8* s, std::streamsize n) { stream_.write(reinterpret_cast<char*>(s), n); crc_.process_bytes(s, n); return *this; }
+		std::streampos tellp() const { return stream_.tellp() + static_cast<std::streamoff>(buffer_.size()); }
+		crc_ostream& seekp(std::streampos pos) { flush(); stream_.seekp(pos); return *this; }
+		crc_ostream& write(const char *s, std::streamsize n) { return write(reinterpret_cast<const uint8*>(s), n); }
+		crc_ostream& write(const uint8* s, std::streamsize n);
+		crc_ostream& flush();
 
-		std::ostream& stream() { return stream_; }
+		std::ostream& stream() { flush(); return stream_; }
 		uint32 checksum() const { return crc_.checksum(); }
 
 	private:
 		std::ostream& stream_;
-		boost::crc_32_type crc_;
+		std::vector<uint8> buffer_;
+		CRC32 crc_;
 	};
 
 std::ostream& operator<<(std::ostream& s, const Wadfile& w);
@@ -32,12 +32,19 @@
 #include "ferro/Wadfile.h"
 
 #include "CLUTResource.h"
+#include "MacBinaryII.h"
 #include "PICTResource.h"
 #include "ResourceManager.h"
 #include "SndResource.h"
+#include "Stats.h"
+#include "ThreadPool.h"
 
+#include <exception>
+#include <functional>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <optional>
 #include <sstream>
 #include <string>
 
@@ -68,13 +75,25 @@ static std::vector<uint8> ReadFile(const fs::path& path)
 	return data;
 }
 
-void MergePhysics(const fs::path& path, marathon::Wad& wad, std::ostream& log)
+void MergePhysics(const fs::path& path, marathon::Wad& wad, marathon::SharedBufferCache& cache, std::ostream& log)
 {
 	marathon::Wadfile wadfile;
-	if (wadfile.Load(path))
+	if (wadfile.Map(path))
 	{
+		// Map only reads the directory, so a damaged wad turns up here
+		const marathon::Wad* wad0;
+		try
+		{
+			wad0 = &wadfile.GetWad(0);
+		}
+		catch (const std::exception&)
+		{
+			log << path << " is not a valid physics model; skipping" << std::endl;
+			return;
+		}
+
 		// check to make sure all physics are present
-		marathon::Wad physics = wadfile.GetWad(0);
+		const marathon::Wad& physics = *wad0;
 		for (std::vector<uint32>::const_iterator it = physics_chunks.begin(); it != physics_chunks.end(); ++it)
 		{
 			if (!physics.HasChunk(*it))
@@ -86,12 +105,12 @@ void MergePhysics(const fs::path& path, marathon::Wad& wad, std::ostream& log)
 
 		for (std::vector<uint32>::const_iterator it = physics_chunks.begin(); it != physics_chunks.end(); ++it)
 		{
-			wad.AddChunk(*it, physics.GetChunk(*it));
+			wad.AddChunk(*it, cache.Intern(physics.GetSharedChunk(*it)));
 		}
 	}
 }
 
-void MergeShapes(const fs::path& path, marathon::Wad& wad, std::ostream& log)
+void MergeShapes(const fs::path& path, marathon::Wad& wad, marathon::SharedBufferCache& cache, std::ostream& log)
 {
 	const uint32 shapes_tag = FOUR_CHARS_TO_INT('S','h','P','a');
 	std::ifstream shapes(path, std::ios::binary | std::ios::ate);
@@ -102,7 +121,7 @@ void MergeShapes(const fs::path& path, marathon::Wad& wad, std::ostream& log)
 		
 		shapes.seekg(0);
 		shapes.read(reinterpret_cast<char*>(&shapes_buffer[0]), shapes_buffer.size());
-		wad.AddChunk(shapes_tag, shapes_buffer);
+		wad.AddChunk(shapes_tag, cache.Intern(std::move(shapes_buffer)));
 	}
 	else
 	{
@@ -110,7 +129,7 @@ void MergeShapes(const fs::path& path, marathon::Wad& wad, std::ostream& log)
 	}
 }
 
-void MergeSounds(const fs::path& path, marathon::Wad& wad, std::ostream& log)
+void MergeSounds(const fs::path& path, marathon::Wad& wad, marathon::SharedBufferCache& cache, std::ostream& log)
 {
 	const uint32_t sounds_tag = FOUR_CHARS_TO_INT('S','n','P','a');
 	std::ifstream sounds(path, std::ios::binary | std::ios::ate);
@@ -121,7 +140,7 @@ void MergeSounds(const fs::path& path, marathon::Wad& wad, std::ostream& log)
 
 		sounds.seekg(0);
 		sounds.read(reinterpret_cast<char*>(sounds_buffer.data()), sounds_buffer.size());
-		wad.AddChunk(sounds_tag, sounds_buffer);
+		wad.AddChunk(sounds_tag, cache.Intern(std::move(sounds_buffer)));
 	}
 	else
 	{
@@ -143,7 +162,7 @@ void MergeTerminal(const fs::path& path, marathon::Wad& wad, std::ostream& log)
 	}
 }
 
-void MergeScripts(const std::vector<fs::path> paths, marathon::Wad& wad, uint32 tag)
+void MergeScripts(const std::vector<fs::path> paths, marathon::Wad& wad, marathon::SharedBufferCache& cache, uint32 tag)
 {
 	marathon::ScriptChunk chunk;
 	for (std::vector<fs::path>::const_iterator it = paths.begin(); it != paths.end(); ++it)
@@ -154,7 +173,7 @@ void MergeScripts(const std::vector<fs::path> paths, marathon::Wad& wad, uint32
 		chunk.AddScript(script);
 	}
 
-	wad.AddChunk(tag, chunk.Save());
+	wad.AddChunk(tag, cache.Intern(chunk.Save()));
 }
 
 struct SortScriptPaths
@@ -168,7 +187,9 @@ struct SortScriptPaths
 	}
 };
 
-marathon::Wad CreateWad(const fs::path& path, std::ostream& log)
+// identical physics, shapes, sounds and scripts in different levels end
+// up sharing one buffer from cache
+marathon::Wad CreateWad(const fs::path& path, marathon::SharedBufferCache& cache, std::ostream& log, Stats* stats = nullptr)
 {
 	marathon::Wad wad;
 
@@ -211,9 +232,13 @@ marathon::Wad CreateWad(const fs::path& path, std::ostream& log)
 			log << path.string() << ": multiple maps found; using " << maps[0].string() << std::endl;
 
 		marathon::Wadfile wadfile;
+		std::optional<Stats::Timer> level_timer;
+		level_timer.emplace(stats, Stats::kLevel);
+		level_timer->file_read(maps[0]);
 		if (wadfile.Load(maps[0].string()) && wadfile.data_version() == 1)
 		{
 			wad = wadfile.GetWad(0);
+			level_timer.reset();
 
 			
 			if (physics.size())
@@ -221,13 +246,17 @@ marathon::Wad CreateWad(const fs::path& path, std::ostream& log)
 				if (physics.size() > 1)
 					log << path.string() << ": multiple physics models found; using " << physics[0].string() << std::endl;
 
-				MergePhysics(physics[0], wad, log);
+				Stats::Timer timer(stats, Stats::kPhysics);
+				timer.file_read(physics[0]);
+				MergePhysics(physics[0], wad, cache, log);
 			}
 			if (shapes.size())
 			{
 				if (shapes.size() > 1)
 					log << path.string() << ": multiple shapes patches found; using " << shapes[0].string() << std::endl;
-				MergeShapes(shapes[0], wad, log);
+				Stats::Timer timer(stats, Stats::kShapes);
+				timer.file_read(shapes[0]);
+				MergeShapes(shapes[0], wad, cache, log);
 			}
 			if (sounds.size())
 			{
@@ -235,23 +264,29 @@ marathon::Wad CreateWad(const fs::path& path, std::ostream& log)
 				{
 					log << path.string() << ": multiple sounds patches found; using " << sounds[0].string() << std::endl;
 				}
-				MergeSounds(sounds[0], wad, log);
+				Stats::Timer timer(stats, Stats::kSounds);
+				timer.file_read(sounds[0]);
+				MergeSounds(sounds[0], wad, cache, log);
 			}
 			if (terminals.size())
 			{
 				if (terminals.size() > 1)
 					log << path.string() << ": multiple terminal texts files found; using " << terminals[0].string() << std::endl;
+				Stats::Timer timer(stats, Stats::kTerminal);
+				timer.file_read(terminals[0]);
 				MergeTerminal(terminals[0], wad, log);
 			}
 			if (luas.size())
 			{
+				Stats::Timer timer(stats, Stats::kScripts);
 				std::sort(luas.begin(), luas.end(), SortScriptPaths());
-				MergeScripts(luas, wad, marathon::ScriptChunk::kLuaTag);
+				MergeScripts(luas, wad, cache, marathon::ScriptChunk::kLuaTag);
 			}
 			if (mmls.size())
 			{
+				Stats::Timer timer(stats, Stats::kScripts);
 				std::sort(mmls.begin(), mmls.end(), SortScriptPaths());
-				MergeScripts(mmls, wad, marathon::ScriptChunk::kMMLTag);
+				MergeScripts(mmls, wad, cache, marathon::ScriptChunk::kMMLTag);
 			}
 		}
 	}
@@ -263,8 +298,37 @@ marathon::Wad CreateWad(const fs::path& path, std::ostream& log)
 	return wad;
 }
 
-void MergeCLUTs(marathon::ResourceManager& resource_manager,
-				const fs::path& path)
+// decodes on a worker, then stores the result in the same order a serial
+// merge would
+static void AddResource(OrderedJobs& jobs,
+						marathon::ResourceManager& resource_manager,
+						marathon::ResourceManager::res_id_t id,
+						Stats* stats,
+						Stats::Phase phase,
+						const fs::path& path,
+						std::function<bool(std::vector<uint8>&)> decode)
+{
+	auto data = std::make_shared<std::vector<uint8> >();
+	auto decoded = std::make_shared<bool>(false);
+
+	jobs.Add([data, decoded, decode, id, stats, phase, path]() {
+		Stats::Timer timer(stats, phase);
+		timer.resource(id.first, id.second);
+		timer.file_read(path);
+		*decoded = decode(*data);
+		timer.bytes_written(data->size());
+	}, [&resource_manager, id, data, decoded]() {
+		if (*decoded)
+		{
+			resource_manager.Add(id, std::move(*data));
+		}
+	});
+}
+
+void MergeCLUTs(OrderedJobs& jobs,
+				marathon::ResourceManager& resource_manager,
+				const fs::path& path,
+				Stats* stats)
 {
 	for (const auto& dir_entry : fs::directory_iterator{path})
 	{
@@ -275,18 +339,24 @@ void MergeCLUTs(marathon::ResourceManager& resource_manager,
 			s >> index;
 			if (!s.fail())
 			{
-				CLUTResource clut;
-				if (clut.Import(dir_entry.path()))
-				{
-					resource_manager.resource_map()[std::make_pair(FOUR_CHARS_TO_INT('c','l','u','t'), index)] = clut.Save();
-				}
+				AddResource(jobs, resource_manager, std::make_pair(FOUR_CHARS_TO_INT('c','l','u','t'), index), stats, Stats::kCLUT, dir_entry.path(), [path = dir_entry.path()](std::vector<uint8>& data) {
+					CLUTResource clut;
+					if (clut.Import(path))
+					{
+						data = clut.Save();
+						return true;
+					}
+					return false;
+				});
 			}
 		}
 	}
 }
 
-void MergePICTs(marathon::ResourceManager& resource_manager,
-				const fs::path& path)
+void MergePICTs(OrderedJobs& jobs,
+				marathon::ResourceManager& resource_manager,
+				const fs::path& path,
+				Stats* stats)
 {
 	for (const auto& dir_entry : fs::directory_iterator{path})
 	{
@@ -297,17 +367,21 @@ void MergePICTs(marathon::ResourceManager& resource_manager,
 			s >> index;
 			if (!s.fail())
 			{
-				PICTResource pict;
-				if (pict.Import(dir_entry.path()))
-				{
-					resource_manager.resource_map()[std::make_pair(FOUR_CHARS_TO_INT('P','I','C','T'), index)] = pict.Save();
-				}
+				AddResource(jobs, resource_manager, std::make_pair(FOUR_CHARS_TO_INT('P','I','C','T'), index), stats, Stats::kPICT, dir_entry.path(), [path = dir_entry.path()](std::vector<uint8>& data) {
+					PICTResource pict;
+					if (pict.Import(path))
+					{
+						data = pict.Save();
+						return true;
+					}
+					return false;
+				});
 			}
 		}
 	}
 }
 
-void MergeSnds(marathon::ResourceManager& resource_manager, const fs::path& path)
+void MergeSnds(OrderedJobs& jobs, marathon::ResourceManager& resource_manager, const fs::path& path, Stats* stats)
 {
 	for (const auto& dir_entry : fs::directory_iterator{path})
 	{
@@ -318,18 +392,24 @@ void MergeSnds(marathon::ResourceManager& resource_manager, const fs::path& path
 			s >> index;
 			if (!s.fail())
 			{
-				SndResource snd;
-				if (snd.Import(dir_entry.path()))
-				{
-					resource_manager.resource_map()[std::make_pair(FOUR_CHARS_TO_INT('s','n','d',' '), index)] = snd.Save();
-				}
+				AddResource(jobs, resource_manager, std::make_pair(FOUR_CHARS_TO_INT('s','n','d',' '), index), stats, Stats::kSnd, dir_entry.path(), [path = dir_entry.path()](std::vector<uint8>& data) {
+					SndResource snd;
+					if (snd.Import(path))
+					{
+						data = snd.Save();
+						return true;
+					}
+					return false;
+				});
 			}
 		}
 	}
 }
 
-void MergeTEXTs(marathon::ResourceManager& resource_manager,
-				const fs::path& path)
+void MergeTEXTs(OrderedJobs& jobs,
+				marathon::ResourceManager& resource_manager,
+				const fs::path& path,
+				Stats* stats)
 {
 	for (const auto& dir_entry : fs::directory_iterator{path})
 	{
@@ -340,7 +420,10 @@ void MergeTEXTs(marathon::ResourceManager& resource_manager,
 			s >> index;
 			if (!s.fail())
 			{
-				resource_manager.resource_map()[std::make_pair(FOUR_CHARS_TO_INT('T','E','X','T'), index)] = ReadFile(dir_entry);
+				AddResource(jobs, resource_manager, std::make_pair(FOUR_CHARS_TO_INT('T','E','X','T'), index), stats, Stats::kTEXT, dir_entry.path(), [path = dir_entry.path()](std::vector<uint8>& data) {
+					data = ReadFile(path);
+					return true;
+				});
 			}
 		}
 	}	
@@ -371,8 +454,10 @@ static std::vector<uint8_t> convert_m1_term(const std::string& m1_term)
 	return out;
 }
 
-void MergeM1Terms(marathon::ResourceManager& resource_manager,
-				  const fs::path& path)
+void MergeM1Terms(OrderedJobs& jobs,
+				  marathon::ResourceManager& resource_manager,
+				  const fs::path& path,
+				  Stats* stats)
 {
 	for (const auto& dir_entry : fs::directory_iterator{path})
 	{
@@ -383,21 +468,26 @@ void MergeM1Terms(marathon::ResourceManager& resource_manager,
 			s >> index;
 			if (!s.fail())
 			{
-				std::ifstream infile{dir_entry.path(), std::ios::ate};
-				auto length = infile.tellg();
-				infile.seekg(0);
+				AddResource(jobs, resource_manager, std::make_pair(FOUR_CHARS_TO_INT('t','e','r','m'), index), stats, Stats::kTerm, dir_entry.path(), [path = dir_entry.path()](std::vector<uint8>& data) {
+					std::ifstream infile{path, std::ios::ate};
+					auto length = infile.tellg();
+					infile.seekg(0);
 
-				std::string m1_term(length, '\0');
-				infile.read(m1_term.data(), m1_term.size());
+					std::string m1_term(length, '\0');
+					infile.read(m1_term.data(), m1_term.size());
 
-				resource_manager.resource_map()[std::make_pair(FOUR_CHARS_TO_INT('t','e','r','m'), index)] = convert_m1_term(m1_term);
+					data = convert_m1_term(m1_term);
+					return true;
+				});
 			}
 		}
 	}
 }
 
-void MergeResourceDir(marathon::ResourceManager& resource_manager,
-					  const fs::path& path)
+void MergeResourceDir(OrderedJobs& jobs,
+					  marathon::ResourceManager& resource_manager,
+					  const fs::path& path,
+				  Stats* stats)
 {
 	try
 	{
@@ -409,7 +499,17 @@ void MergeResourceDir(marathon::ResourceManager& resource_manager,
 			s >> index;
 			if (!s.fail())
 			{
-				resource_manager.resource_map()[std::make_pair(res_type, index)] = ReadFile(dir_entry);
+				AddResource(jobs, resource_manager, std::make_pair(res_type, index), stats, Stats::kResource, dir_entry.path(), [path = dir_entry.path()](std::vector<uint8>& data) {
+					try
+					{
+						data = ReadFile(path);
+						return true;
+					}
+					catch (const std::exception&)
+					{
+						return false;
+					}
+				});
 			}
 		}
 	}
@@ -419,8 +519,10 @@ void MergeResourceDir(marathon::ResourceManager& resource_manager,
 	}
 }
 
-void MergeResources(marathon::ResourceManager& resource_manager,
-					const fs::path& path)
+void MergeResources(OrderedJobs& jobs,
+					marathon::ResourceManager& resource_manager,
+					const fs::path& path,
+					Stats* stats)
 {
 	for (const auto& dir_entry : fs::directory_iterator{path})
 	{
@@ -429,27 +531,27 @@ void MergeResources(marathon::ResourceManager& resource_manager,
 			auto filename = dir_entry.path().filename();
 			if (filename == "TEXT")
 			{
-				MergeTEXTs(resource_manager, dir_entry);
+				MergeTEXTs(jobs, resource_manager, dir_entry, stats);
 			}
 			else if (filename == "CLUT")
 			{
-				MergeCLUTs(resource_manager, dir_entry);
+				MergeCLUTs(jobs, resource_manager, dir_entry, stats);
 			}
 			else if (filename == "PICT")
 			{
-				MergePICTs(resource_manager, dir_entry);
+				MergePICTs(jobs, resource_manager, dir_entry, stats);
 			}
 			else if (filename == "snd")
 			{
-				MergeSnds(resource_manager, dir_entry);
+				MergeSnds(jobs, resource_manager, dir_entry, stats);
 			}
 			else if (filename == "term")
 			{
-				MergeM1Terms(resource_manager, dir_entry);
+				MergeM1Terms(jobs, resource_manager, dir_entry, stats);
 			}
 			else
 			{
-				MergeResourceDir(resource_manager, dir_entry);
+				MergeResourceDir(jobs, resource_manager, dir_entry, stats);
 			}
 		}
 	}
@@ -481,7 +583,31 @@ static std::string get_line(std::istream& stream)
 	return line;
 }
 
-void atque::merge(const fs::path& src, const fs::path& dest, std::ostream& log)
+static std::map<int16, std::string> LoadLevelSelectNames(const fs::path& src)
+{
+	fs::path level_select_path(src);
+	level_select_path = level_select_path / "Level Select Names.txt";
+	
+	std::map<int16, std::string> level_select_names;
+	if (fs::exists(level_select_path))
+	{
+		std::ifstream s(level_select_path.string().c_str());
+		while (!s.eof() && !s.fail())
+		{
+			int16 index;
+			s >> index;
+			if (!s.fail())
+			{
+				s.ignore();
+				level_select_names[index] = get_line(s);
+			}
+		}
+	}
+
+	return level_select_names;
+}
+
+void atque::merge(const fs::path& src, const fs::path& dest, std::ostream& log, const merge_options& options)
 {
 	if (!fs::exists(src))
 	{
@@ -493,22 +619,33 @@ void atque::merge(const fs::path& src, const fs::path& dest, std::ostream& log)
 	}
 
 	marathon::ResourceManager resource_manager;
+	marathon::SharedBufferCache cache;
+	OrderedJobs jobs(options.jobs);
 
 	if (fs::exists(src / "Data.bin"))
 	{
-		MergeResources(resource_manager, src / "Resources");
+		MergeResources(jobs, resource_manager, src / "Resources", options.stats);
+		jobs.Finish();
 		if (resource_manager.CanSaveToResourceFork())
 		{
-			resource_manager.Save(dest, [&](std::ostream& stream) {
-				std::ifstream data_fork{src / "Data.bin",
-										std::ios::binary | std::ios::ate};
-				auto length = data_fork.tellg();
-				data_fork.seekg(0, std::ios::beg);
-
-				std::vector<uint8_t> data(length);
-				data_fork.read(reinterpret_cast<char*>(data.data()), data.size());
-				stream.write(reinterpret_cast<char*>(data.data()), data.size());
-			});
+			// copy the data fork across a block at a time rather than
+			// holding all of it
+			auto data_fork_path = src / "Data.bin";
+			Stats::Timer timer(options.stats, Stats::kWrite);
+			timer.file_read(data_fork_path);
+			if (!resource_manager.Save(dest, [&](std::ostream& stream) {
+				std::ifstream data_fork{data_fork_path, std::ios::binary};
+				std::vector<char> block(1 << 20);
+				while (data_fork)
+				{
+					data_fork.read(block.data(), block.size());
+					stream.write(block.data(), data_fork.gcount());
+				}
+			}, options.fork_format, fs::file_size(data_fork_path)))
+			{
+				throw merge_error("could not write " + dest.string());
+			}
+			timer.file_written(dest);
 			return;
 		}
 		else
@@ -519,24 +656,7 @@ void atque::merge(const fs::path& src, const fs::path& dest, std::ostream& log)
 
 	marathon::Wadfile wadfile;
 	
-	fs::path level_select_path(src);
-	level_select_path = level_select_path / "Level Select Names.txt";
-	
-	std::map<int16, std::string> level_select_names;
-	if (fs::exists(level_select_path))
-	{
-		std::ifstream s(level_select_path.string().c_str());
-		while (!s.eof() && !s.fail())
-		{
-			int16 index;
-			s >> index;
-			if (!s.fail())
-			{
-				s.ignore();
-				level_select_names[index] = get_line(s);
-			}
-		}
-	}
+	std::map<int16, std::string> level_select_names = LoadLevelSelectNames(src);
 
 	for (const auto& dir_entry : fs::directory_iterator{src})
 	{
@@ -544,7 +664,7 @@ void atque::merge(const fs::path& src, const fs::path& dest, std::ostream& log)
 		{
 			if (dir_entry.path().filename() == "Resources")
 			{
-				MergeResources(resource_manager, dir_entry);
+				MergeResources(jobs, resource_manager, dir_entry, options.stats);
 			}
 			else
 			{
@@ -560,13 +680,38 @@ void atque::merge(const fs::path& src, const fs::path& dest, std::ostream& log)
 					{
 						std::string level_name;
 						std::getline(s, level_name);
-						wadfile.SetWad(index, CreateWad(dir_entry, log));
+
+						// hold on to the level's log, and any error, until
+						// it's this level's turn
+						auto wad = std::make_shared<marathon::Wad>();
+						auto level_log = std::make_shared<std::ostringstream>();
+						auto error = std::make_shared<std::exception_ptr>();
+						jobs.Add([wad, level_log, error, &cache, &jobs, stats = options.stats, path = dir_entry.path()]() {
+							try
+							{
+								*wad = CreateWad(path, cache, *level_log, stats);
+							}
+							catch (...)
+							{
+								*error = std::current_exception();
+								jobs.Cancel();
+							}
+						}, [&wadfile, &log, index, wad, level_log, error]() {
+							log << level_log->str();
+							if (*error)
+							{
+								std::rethrow_exception(*error);
+							}
+							wadfile.SetWad(index, std::move(*wad));
+						});
 					} 
 				}
 			}
 		}
 	}
 
+	jobs.Finish();
+
 	for (std::map<int16, std::string>::iterator it = level_select_names.begin(); it != level_select_names.end(); ++it)
 	{
 		if (wadfile.HasWad(it->first))
@@ -577,21 +722,91 @@ void atque::merge(const fs::path& src, const fs::path& dest, std::ostream& log)
 
 	wadfile.file_name(utf8_to_mac_roman(fs::path(dest).stem().u8string()));
 
-	if (resource_manager.CanSaveToResourceFork())
+	Stats::Timer write_timer(options.stats, Stats::kWrite);
+
+	// if the fork is too big, move the biggest sounds and pictures into
+	// the wadfile, so there's still a fork for older tools
+	auto layout = resource_manager.PlanForkLayout(wadfile);
+	if (layout.fits)
 	{
-		resource_manager.Save(dest, [&](std::ostream& stream) {
-			wadfile.Save(stream);
-		});
+		if (layout.wadfile_resources.size())
+		{
+			log << "Resources are too big for the resource fork; moving "
+				<< layout.wadfile_resources.size() << " of them ("
+				<< layout.wadfile_data_length << " bytes) into the wadfile, leaving "
+				<< layout.fork_data_length << " bytes in the fork" << std::endl;
+			resource_manager.SaveToWadfile(wadfile, layout);
+		}
+		
+		if (!resource_manager.Save(dest, [&](std::ostream& stream) {
+				wadfile.Save(stream);
+			}, options.fork_format))
+		{
+			throw merge_error("could not write " + dest.string());
+		}
+		write_timer.file_written(dest);
 	}
 	else if (resource_manager.CanSaveToWadfile(wadfile))
 	{
 		resource_manager.SaveToWadfile(wadfile);
 
-		std::ofstream stream(dest, std::ios_base::binary);
-		wadfile.Save(stream);
+		{
+			std::ofstream stream(dest, std::ios_base::binary);
+			wadfile.Save(stream);
+		}
+		write_timer.file_written(dest);
 	}
 	else
 	{
 		throw merge_error("resources too big to save to fork, and resource ids overlap map levels");		
 	}
 }
+
+void atque::update(const fs::path& src, const fs::path& dest, std::ostream& log)
+{
+	if (!fs::is_directory(src))
+	{
+		throw merge_error("source must be a level directory");
+	}
+
+	if (!fs::exists(dest))
+	{
+		throw merge_error(dest.string() + " does not exist");
+	}
+
+	std::istringstream s(src.filename().string());
+	int16 index;
+	s >> index;
+	if (s.fail())
+	{
+		throw merge_error(src.string() + " does not start with a level number");
+	}
+
+	{
+		MacBinaryII header;
+		std::ifstream stream(dest, std::ios::binary);
+		stream.read(reinterpret_cast<char*>(&header), sizeof(header));
+		if (stream && header.IsValid())
+		{
+			throw merge_error("MacBinary scenarios can't be updated; merge the whole scenario instead");
+		}
+	}
+
+	marathon::SharedBufferCache cache;
+	auto wad = CreateWad(src, cache, log);
+
+	// the level select name lives next to the level folders
+	std::string level_name;
+	auto level_select_names = LoadLevelSelectNames(src.parent_path());
+	if (level_select_names.count(index))
+	{
+		level_name = utf8_to_mac_roman(level_select_names[index]);
+	}
+
+	// in place, so hard links and extended attributes survive; Update
+	// writes the header last, so an interrupted update changes nothing
+	if (!marathon::Wadfile::Update(dest, index, wad, level_name))
+	{
+		throw merge_error("could not update " + dest.string());
+	}
+}
@@ -27,16 +27,39 @@
 #include <string>
 #include <vector>
 
+#include "ResourceManager.h"
+
 namespace atque
 {
+class Stats;
+
 class merge_error : public std::runtime_error {
 public:
 	merge_error(const std::string& what) : std::runtime_error(what) { }
 };
 
+struct merge_options {
+	// number of levels and resources built at once
+	int jobs = 1;
+
+	// where the resource fork goes, when there is one
+	marathon::ResourceManager::ForkFormat fork_format = marathon::ResourceManager::ForkFormat::MacBinary;
+
+	// if set, where the time goes
+	Stats* stats = nullptr;
+};
+
 void merge(const std::filesystem::path& source,
 		   const std::filesystem::path& destination,
-		   std::ostream& log);
+		   std::ostream& log,
+		   const merge_options& options = merge_options());
+
+// replaces one level in an existing (bare, not MacBinary) scenario with
+// the contents of a single level folder, without rebuilding the rest;
+// the file is patched in place
+void update(const std::filesystem::path& level_folder,
+			const std::filesystem::path& destination,
+			std::ostream& log);
 }
 
 #endif
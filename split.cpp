@@ -33,10 +33,16 @@
 #include "PICTResource.h"
 #include "ResourceManager.h"
 #include "SndResource.h"
+#include "Stats.h"
+#include "ThreadPool.h"
 
+#include <algorithm>
+#include <atomic>
 #include <filesystem>
+#include <future>
 #include <iostream>
 #include <iomanip>
+#include <map>
 #include <optional>
 #include <sstream>
 #include <set>
@@ -85,7 +91,7 @@ const std::vector<uint32> physics_chunks = boost::assign::list_of
 	;
 
 // removes physics chunks from wad, and saves file
-void SavePhysics(marathon::Wad& wad, const std::string& name, const std::string& path)
+bool SavePhysics(marathon::Wad& wad, const std::string& name, const std::string& path)
 {
 	marathon::Wad physicsWad;
 	bool has_physics = false;
@@ -94,7 +100,7 @@ void SavePhysics(marathon::Wad& wad, const std::string& name, const std::string&
 	{
 		if (wad.HasChunk(*it))
 		{
-			physicsWad.AddChunk(*it, wad.GetChunk(*it));
+			physicsWad.AddChunk(*it, wad.GetSharedChunk(*it));
 			wad.RemoveChunk(*it);
 			has_physics = true;
 		}
@@ -104,12 +110,14 @@ void SavePhysics(marathon::Wad& wad, const std::string& name, const std::string&
 	{
 		// export it!
 		marathon::Wadfile wadfile;
-		wadfile.SetWad(0, physicsWad);
+		wadfile.SetWad(0, std::move(physicsWad));
 		wadfile.data_version(0);
 		wadfile.file_name(name);
 		wadfile.Save(path);
 		set_type_code(path, "phy\260");
 	}
+
+	return has_physics;
 }
 
 void SaveLevel(marathon::Wad& wad, const std::string& name, const fs::path& path)
@@ -123,36 +131,44 @@ void SaveLevel(marathon::Wad& wad, const std::string& name, const fs::path& path
 }
 
 // removes shapes chunk from Wad, and saves file
-void SaveShapes(marathon::Wad& wad, const fs::path& path)
+bool SaveShapes(marathon::Wad& wad, const fs::path& path)
 {
+	bool saved = false;
 	const uint32 shapes_tag = FOUR_CHARS_TO_INT('S','h','P','a');
 	if (wad.HasChunk(shapes_tag))
 	{
-		const std::vector<uint8>& data = wad.GetChunk(shapes_tag);
+		const marathon::SharedBuffer& data = wad.GetSharedChunk(shapes_tag);
 		if (data.size())
 		{
 			std::ofstream outfile(path, std::ios::trunc | std::ios::binary);
-			outfile.write(reinterpret_cast<const char*>(&data[0]), data.size());
+			outfile.write(reinterpret_cast<const char*>(data.data()), data.size());
 			set_type_code(path, "ShPa");
+			saved = true;
 		}
 		wad.RemoveChunk(shapes_tag);
 	}
+
+	return saved;
 }
 
-void SaveSounds(marathon::Wad& wad, const fs::path& path)
+bool SaveSounds(marathon::Wad& wad, const fs::path& path)
 {
+	bool saved = false;
 	const uint32_t sounds_tag = FOUR_CHARS_TO_INT('S','n','P','a');
 	if (wad.HasChunk(sounds_tag))
 	{
-		const std::vector<uint8_t>& data = wad.GetChunk(sounds_tag);
+		const marathon::SharedBuffer& data = wad.GetSharedChunk(sounds_tag);
 		if (data.size())
 		{
 			std::ofstream outfile(path, std::ios::trunc | std::ios::binary);
 			outfile.write(reinterpret_cast<const char*>(data.data()), data.size());
 			set_type_code(path, "SnPa");
+			saved = true;
 		}
 		wad.RemoveChunk(sounds_tag);
 	}
+
+	return saved;
 }
 
 void SaveScripts(marathon::Wad& wad, const fs::path& dir)
@@ -202,16 +218,16 @@ void SaveScripts(marathon::Wad& wad, const fs::path& dir)
 
 }
 
-void SaveTEXT(const std::vector<uint8_t>& data, const fs::path& path)
+void SaveTEXT(const marathon::SharedBuffer& data, const fs::path& path)
 {
 	if (data.size())
 	{
 		std::ofstream outfile(path, std::ios::trunc);
-		outfile.write(reinterpret_cast<const char*>(&data[0]), data.size());
+		outfile.write(reinterpret_cast<const char*>(data.data()), data.size());
 	}
 }
 
-void SaveM1Term(const std::vector<uint8_t>& data, const fs::path& path)
+void SaveM1Term(const marathon::SharedBuffer& data, const fs::path& path)
 {
 	if (data.size())
 	{
@@ -295,7 +311,223 @@ static std::string sanitize(const std::string& input)
 	return result;
 }
 
-void atque::split(const fs::path& src, const fs::path& dest, std::ostream& log)
+namespace {
+
+// files that are often identical from one level to the next
+enum SharedFile {
+	kPhysicsFile,
+	kShapesFile,
+	kSoundsFile,
+	kSharedFileCount
+};
+
+const std::vector<uint32> shared_file_tags[kSharedFileCount] = {
+	physics_chunks,
+	{ FOUR_CHARS_TO_INT('S','h','P','a') },
+	{ FOUR_CHARS_TO_INT('S','n','P','a') }
+};
+
+const char* shared_file_types[kSharedFileCount] = {
+	"phy\260",
+	"ShPa",
+	"SnPa"
+};
+
+// one level folder; Run touches nothing but its own wad and folder,
+// so any number of them can run at once
+struct LevelJob
+{
+	int16 index = 0;
+	marathon::Wad wad;
+	std::string level;
+
+	// which earlier job's copy of each file to link to, instead of
+	// writing another one
+	int link_to[kSharedFileCount] = { -1, -1, -1 };
+
+	std::string actual_level;
+	fs::path paths[kSharedFileCount];
+	bool saved[kSharedFileCount] = { };
+	bool failed = false;
+
+	Stats* stats = nullptr;
+
+	void Run(const fs::path& dest);
+};
+
+// finds levels whose physics, shapes or sounds match an earlier level's
+void FindDuplicates(std::vector<LevelJob>& jobs)
+{
+	marathon::SharedBufferCache cache;
+	std::map<std::vector<std::pair<uint32, const uint8*> >, int> owners[kSharedFileCount];
+
+	for (int i = 0; i < static_cast<int>(jobs.size()); ++i)
+	{
+		auto& job = jobs[i];
+		for (int file = 0; file < kSharedFileCount; ++file)
+		{
+			// interned buffers with the same contents have the same
+			// address
+			std::vector<std::pair<uint32, const uint8*> > contents;
+			for (auto tag : shared_file_tags[file])
+			{
+				if (job.wad.HasChunk(tag))
+				{
+					auto buffer = cache.Intern(job.wad.GetSharedChunk(tag));
+					if (buffer.size())
+					{
+						contents.push_back(std::make_pair(tag, buffer.data()));
+					}
+				}
+			}
+
+			if (contents.size())
+			{
+				auto [it, inserted] = owners[file].insert(std::make_pair(contents, i));
+				if (!inserted)
+				{
+					job.link_to[file] = it->second;
+				}
+			}
+		}
+	}
+}
+
+Stats::Phase resource_phase(uint32_t type)
+{
+	switch (type)
+	{
+	case FOUR_CHARS_TO_INT('P','I','C','T'):
+	case FOUR_CHARS_TO_INT('p','i','c','t'):
+		return Stats::kPICT;
+	case FOUR_CHARS_TO_INT('T','E','X','T'):
+	case FOUR_CHARS_TO_INT('t','e','x','t'):
+		return Stats::kTEXT;
+	case FOUR_CHARS_TO_INT('c','l','u','t'):
+		return Stats::kCLUT;
+	case FOUR_CHARS_TO_INT('s','n','d',' '):
+		return Stats::kSnd;
+	case FOUR_CHARS_TO_INT('t','e','r','m'):
+		return Stats::kTerm;
+	default:
+		return Stats::kResource;
+	}
+}
+
+void LinkFile(const fs::path& target, const fs::path& path, const std::string& type)
+{
+	std::error_code ec;
+	fs::remove(path, ec);
+	fs::create_hard_link(target, path, ec);
+	if (ec)
+	{
+		fs::copy_file(target, path, fs::copy_options::overwrite_existing);
+		set_type_code(path.string(), type);
+	}
+}
+
+void LevelJob::Run(const fs::path& dest)
+{
+	try
+	{
+		{
+			Stats::Timer timer(stats, Stats::kMapInfo);
+			marathon::MapInfo minf(wad.GetChunk(marathon::MapInfo::kTag));
+			actual_level = minf.level_name();
+		}
+
+		auto folder_level = sanitize(level);
+		auto file_level = sanitize(actual_level);
+
+		std::ostringstream level_number;
+		level_number << std::setw(2) << std::setfill('0') << index;
+
+		auto destfolder = dest;
+		destfolder /= level_number.str() + " ";
+		destfolder += fs::u8path(mac_roman_to_utf8(folder_level));
+		fs::create_directory(destfolder);
+
+		auto& physics_path = paths[kPhysicsFile];
+		physics_path = destfolder;
+		physics_path /= fs::u8path(mac_roman_to_utf8(file_level));
+		physics_path += ".phyA";
+
+		auto& shapes_path = paths[kShapesFile];
+		shapes_path = destfolder;
+		shapes_path /= fs::u8path(mac_roman_to_utf8(file_level));
+		shapes_path += ".ShPa";
+
+		auto& sounds_path = paths[kSoundsFile];
+		sounds_path = destfolder;
+		sounds_path /= fs::u8path(mac_roman_to_utf8(file_level));
+		sounds_path += ".SnPa";
+
+		// duplicates are linked once every level is written
+		for (int file = 0; file < kSharedFileCount; ++file)
+		{
+			if (link_to[file] >= 0)
+			{
+				for (auto tag : shared_file_tags[file])
+				{
+					wad.RemoveChunk(tag);
+				}
+			}
+		}
+
+		if (link_to[kPhysicsFile] < 0)
+		{
+			Stats::Timer timer(stats, Stats::kPhysics);
+			saved[kPhysicsFile] = SavePhysics(wad, file_level, physics_path.string());
+			if (saved[kPhysicsFile])
+				timer.file_written(physics_path);
+		}
+		if (link_to[kShapesFile] < 0)
+		{
+			Stats::Timer timer(stats, Stats::kShapes);
+			saved[kShapesFile] = SaveShapes(wad, shapes_path);
+			if (saved[kShapesFile])
+				timer.file_written(shapes_path);
+		}
+		if (link_to[kSoundsFile] < 0)
+		{
+			Stats::Timer timer(stats, Stats::kSounds);
+			saved[kSoundsFile] = SaveSounds(wad, sounds_path);
+			if (saved[kSoundsFile])
+				timer.file_written(sounds_path);
+		}
+
+		auto terminal_path = destfolder;
+		terminal_path /= fs::u8path(mac_roman_to_utf8(file_level));
+		terminal_path += ".term.txt";
+		{
+			Stats::Timer timer(stats, Stats::kTerminal);
+			SaveTerminal(wad, terminal_path.string());
+			timer.file_written(terminal_path);
+		}
+
+		{
+			Stats::Timer timer(stats, Stats::kScripts);
+			SaveScripts(wad, destfolder);
+		}
+
+		auto level_path = destfolder;
+		level_path /= fs::u8path(mac_roman_to_utf8(file_level));
+		level_path += ".sceA";
+		{
+			Stats::Timer timer(stats, Stats::kLevel);
+			SaveLevel(wad, file_level, level_path.string());
+			timer.file_written(level_path);
+		}
+	}
+	catch (const std::exception&)
+	{
+		failed = true;
+	}
+}
+
+}
+
+void atque::split(const fs::path& src, const fs::path& dest, std::ostream& log, const split_options& options)
 {
 	if (!fs::exists(src))
 	{
@@ -310,19 +542,32 @@ void atque::split(const fs::path& src, const fs::path& dest, std::ostream& log)
 	marathon::ResourceManager resource_manager;
 	std::optional<marathon::Wadfile> wadfile;
 	std::optional<std::vector<uint8_t>> data_fork;
+
+	// only MacBinary files and wadfiles are worth mapping for levels
+	bool may_hold_levels = marathon::ResourceManager::Classify(src) != marathon::ResourceManager::FileKind::Raw;
+
+	// runs until the levels have been pulled out of the wadfile
+	std::optional<Stats::Timer> load_timer;
+	load_timer.emplace(options.stats, Stats::kLoad);
+	load_timer->file_read(src);
 	
 	if (!resource_manager.Load(src, [&](std::istream& stream,
 										std::streamsize length)
 		{
 			auto start = stream.tellg();
 			
+			// map the data fork so only the levels we touch get read
 			marathon::Wadfile check_wad;
-			if (check_wad.Load(stream) &&
+			if (may_hold_levels &&
+				check_wad.Map(src, start, length) &&
 				check_wad.version() >= 1 &&
 				check_wad.data_version() == 1 &&
 				check_wad.GetWadIndexes().size())
 			{
-				resource_manager.LoadFromWadfile(check_wad);
+				if (options.resources)
+				{
+					resource_manager.LoadFromWadfile(check_wad);
+				}
 				wadfile = std::move(check_wad);
 			}
 			else
@@ -333,11 +578,21 @@ void atque::split(const fs::path& src, const fs::path& dest, std::ostream& log)
 				stream.read(reinterpret_cast<char*>(data.data()), data.size());
 				data_fork = std::move(data);
 			}
-		}))
+		}, options.resources))
 	{
 		throw split_error("error loading resource or data fork");
 	};
 
+	if (options.levels.size() && !wadfile)
+	{
+		throw split_error(src.string() + " does not contain any levels");
+	}
+
+	if (options.verify && wadfile && !wadfile->VerifyChecksum())
+	{
+		throw split_error(src.string() + ": checksum does not match; the file may be damaged");
+	}
+
 	if (!fs::exists(dest))
 	{
 		if (!fs::create_directory(dest))
@@ -350,88 +605,171 @@ void atque::split(const fs::path& src, const fs::path& dest, std::ostream& log)
 
 	if (wadfile)
 	{
+		// Wadfile parses lazily, so pull everything the workers need
+		// out of it before they start
+		std::vector<LevelJob> jobs;
 		for (const auto& index : wadfile->GetWadIndexes())
 		{
-			marathon::Wad wad = wadfile->GetWad(index);
+			// the directory is enough to skip levels nobody asked for
+			if (options.levels.size() && !options.levels.count(index))
+			{
+				continue;
+			}
+
+			// Map only reads the directory, so a damaged wad turns up here
+			const marathon::Wad* parsed;
+			try
+			{
+				parsed = &wadfile->GetWad(index);
+			}
+			catch (const std::exception&)
+			{
+				if (options.levels.count(index))
+				{
+					std::ostringstream error;
+					error << "level " << index << " is damaged";
+					throw split_error(error.str());
+				}
+
+				log << src.string() << ": wad " << index << " is damaged; skipping" << std::endl;
+				continue;
+			}
+
+			const marathon::Wad& wad = *parsed;
 			if (wad.HasChunk(marathon::MapInfo::kTag))
 			{
-				try
+				LevelJob job;
+				job.index = index;
+				job.wad = wad;
+				job.level = wadfile->GetLevelName(index);
+				job.stats = options.stats;
+				jobs.push_back(std::move(job));
+			}
+		}
+
+		for (auto index : options.levels)
+		{
+			if (std::none_of(jobs.begin(), jobs.end(), [index](const LevelJob& job) { return job.index == index; }))
+			{
+				std::ostringstream error;
+				error << "level " << index << " not found";
+				throw split_error(error.str());
+			}
+		}
+
+		load_timer.reset();
+
+		if (options.link_duplicates)
+		{
+			FindDuplicates(jobs);
+		}
+
+		if (options.jobs > 1 && jobs.size() > 1)
+		{
+			std::atomic<bool> abort{false};
+			std::vector<std::future<void>> futures;
+			{
+				ThreadPool pool(std::min<int>(options.jobs, jobs.size()));
+				for (auto& job : jobs)
 				{
-					marathon::MapInfo minf(wad.GetChunk(marathon::MapInfo::kTag));
-					
-					std::string level = wadfile->GetLevelName(index);
-					std::string actual_level = minf.level_name();
-					if (level != actual_level)
-					{
-						level_select_names[index] = level;
-					}
-					
-					level = sanitize(level);
-					actual_level = sanitize(actual_level);
-					
-					std::ostringstream level_number;
-					level_number << std::setw(2) << std::setfill('0') << index;
-					
-					auto destfolder = dest;
-					destfolder /= level_number.str() + " ";
-					destfolder += fs::u8path(mac_roman_to_utf8(level));
-					fs::create_directory(destfolder);
-					
-					auto physics_path = destfolder;
-					physics_path /= fs::u8path(mac_roman_to_utf8(actual_level));
-					physics_path += ".phyA";
-					SavePhysics(wad, actual_level, physics_path);
-					
-					auto shapes_path = destfolder;
-					shapes_path = fs::u8path(mac_roman_to_utf8(actual_level));
-					shapes_path += ".ShPa";
-					SaveShapes(wad, shapes_path);
-					
-					auto sounds_path = destfolder;
-					sounds_path /= fs::u8path(mac_roman_to_utf8(actual_level));
-					sounds_path += ".SnPa";
-					SaveSounds(wad, sounds_path);
-					
-					auto terminal_path = destfolder;
-					terminal_path /= fs::u8path(mac_roman_to_utf8(actual_level));
-					terminal_path += ".term.txt";
-					SaveTerminal(wad, terminal_path.string());
-					
-					SaveScripts(wad, destfolder);
-					
-					auto level_path = destfolder;
-					level_path /= fs::u8path(mac_roman_to_utf8(actual_level));
-					level_path += ".sceA";
-					SaveLevel(wad, actual_level, level_path.string());
+					futures.push_back(pool.Submit([&job, &dest, &abort]() {
+						if (!abort)
+						{
+							job.Run(dest);
+							if (job.failed)
+							{
+								abort = true;
+							}
+						}
+					}));
 				}
-				catch (const std::exception&)
+			}
+
+			for (auto& future : futures)
+			{
+				future.get();
+			}
+		}
+		else
+		{
+			for (auto& job : jobs)
+			{
+				job.Run(dest);
+				if (job.failed)
 				{
-					std::ostringstream error;
-					error << "error writing level " << index << "; aborting";
-					throw split_error(error.str());
+					break;
 				}
-			}				
+			}
+		}
+
+		// report the first level that failed, same as a serial split
+		for (const auto& job : jobs)
+		{
+			if (job.failed)
+			{
+				std::ostringstream error;
+				error << "error writing level " << job.index << "; aborting";
+				throw split_error(error.str());
+			}
+
+			if (job.level != job.actual_level)
+			{
+				level_select_names[job.index] = job.level;
+			}
+		}
+
+		Stats::Timer link_timer(options.stats, Stats::kLink);
+		for (const auto& job : jobs)
+		{
+			for (int file = 0; file < kSharedFileCount; ++file)
+			{
+				if (job.link_to[file] >= 0)
+				{
+					const auto& owner = jobs[job.link_to[file]];
+					if (owner.saved[file])
+					{
+						try
+						{
+							LinkFile(owner.paths[file], job.paths[file], shared_file_types[file]);
+						}
+						catch (const fs::filesystem_error&)
+						{
+							throw split_error("error linking " + job.paths[file].string());
+						}
+					}
+				}
+			}
 		}
 	}
 	else
 	{
+		load_timer.reset();
+
+		Stats::Timer timer(options.stats, Stats::kWrite);
 		fs::path data_fork_path(dest);
 		data_fork_path = data_fork_path / "Data.bin";
 		std::ofstream s{data_fork_path.string().c_str(), std::ios::out | std::ios::binary | std::ios::trunc};
 		s.write(reinterpret_cast<char*>(data_fork->data()), data_fork->size());
+		timer.bytes_written(data_fork->size());
 	}
 
 	fs::path resource_path = fs::path(dest) / "Resources";
-	if (resource_manager.resource_map().size())
+	if (!resource_manager.empty())
 	{
 		fs::create_directory(resource_path);
 	}
 
 	std::map<int16, std::string> resource_names;
 
-	for (const auto& [res_id, res_data] : resource_manager.resource_map())
+	for (const auto& resource : resource_manager.resources())
 	{
-		const auto& [res_type, res_index] = res_id;
+		auto res_type = resource.type();
+		auto res_index = resource.id();
+		const auto& res_data = resource.data;
+
+		Stats::Timer timer(options.stats, resource_phase(res_type));
+		timer.resource(res_type, res_index);
+		timer.bytes_read(res_data.size());
 		
 		std::ostringstream id;
 		id << std::setw(5) << std::setfill('0') << res_index;
@@ -446,18 +784,18 @@ void atque::split(const fs::path& src, const fs::path& dest, std::ostream& log)
 			PICTResource pict;
 			if (res_type == FOUR_CHARS_TO_INT('P','I','C','T'))
 			{
-				pict.Load(res_data);
+				pict.Load(res_data.vector());
 			}
 			else
 			{
-				auto clut_data = resource_manager.resource_map()[std::make_pair(FOUR_CHARS_TO_INT('c','l','u','t'), res_index)];
-				pict.LoadRaw(res_data, clut_data);
+				auto clut = resource_manager.Find(std::make_pair(FOUR_CHARS_TO_INT('c','l','u','t'), res_index));
+				pict.LoadRaw(res_data.vector(), clut ? clut->data.vector() : std::vector<uint8>());
 			}
 
 			if (pict.IsUnparsed())
 				log << "Exporting PICT " << res_index << " as .pct (" << pict.WhyUnparsed() << ")" << std::endl;
 
-			pict.Export(pict_path.string());
+			timer.file_written(pict.Export(pict_path.string()));
 		}
 		else if (res_type == FOUR_CHARS_TO_INT('T','E','X','T') ||
 				 res_type == FOUR_CHARS_TO_INT('t','e','x','t'))
@@ -467,6 +805,7 @@ void atque::split(const fs::path& src, const fs::path& dest, std::ostream& log)
 
 			auto text_path = text_dir / (id.str() + ".txt");
 			SaveTEXT(res_data, text_path.string());
+			timer.file_written(text_path);
 		}
 		else if (res_type == FOUR_CHARS_TO_INT('c','l','u','t'))
 		{
@@ -474,8 +813,9 @@ void atque::split(const fs::path& src, const fs::path& dest, std::ostream& log)
 			fs::create_directory(clut_dir);
 			
 			auto clut_path = clut_dir / (id.str() + ".act");
-			CLUTResource clut(res_data);
+			CLUTResource clut(res_data.vector());
 			clut.Export(clut_path.string());
+			timer.file_written(clut_path);
 		}
 		else if (res_type == FOUR_CHARS_TO_INT('s','n','d',' '))
 		{
@@ -483,8 +823,9 @@ void atque::split(const fs::path& src, const fs::path& dest, std::ostream& log)
 			fs::create_directory(snd_dir);
 			
 			auto snd_path = snd_dir / (id.str() + ".wav");
-			SndResource snd(res_data);
+			SndResource snd(res_data.vector());
 			snd.Export(snd_path.string());
+			timer.file_written(snd_path);
 		}
 		else if (res_type == FOUR_CHARS_TO_INT('t','e','r','m'))
 		{
@@ -493,6 +834,7 @@ void atque::split(const fs::path& src, const fs::path& dest, std::ostream& log)
 
 			auto term_path = term_dir / (id.str() + ".txt");
 			SaveM1Term(res_data, term_path);
+			timer.file_written(term_path);
 		}
 		else
 		{
@@ -505,17 +847,110 @@ void atque::split(const fs::path& src, const fs::path& dest, std::ostream& log)
 			fs::path res_path = res_dir / (id.str() + ".bin");
 			std::ofstream stream{res_path.string(), std::ios_base::binary | std::ios_base::trunc};
 			stream.write(reinterpret_cast<const char*>(res_data.data()), res_data.size());
+			timer.bytes_written(res_data.size());
 		}
 	}
 
 	if (level_select_names.size())
 	{
+		Stats::Timer timer(options.stats, Stats::kWrite);
 		fs::path level_select_path(dest);
 		level_select_path = level_select_path / "Level Select Names.txt";
-		std::ofstream s(level_select_path.string().c_str(), std::ios::out);
-		for (std::map<int16, std::string>::iterator it = level_select_names.begin(); it != level_select_names.end(); ++it)
 		{
-			s << it->first << " " << mac_roman_to_utf8(it->second) << std::endl;
+			std::ofstream s(level_select_path.string().c_str(), std::ios::out);
+			for (std::map<int16, std::string>::iterator it = level_select_names.begin(); it != level_select_names.end(); ++it)
+			{
+				s << it->first << " " << mac_roman_to_utf8(it->second) << std::endl;
+			}
+		}
+		timer.file_written(level_select_path);
+	}
+}
+
+void atque::list(const fs::path& src, std::ostream& out, bool verify)
+{
+	if (!fs::exists(src))
+	{
+		throw split_error(src.string() + " does not exist");
+	}
+
+	marathon::ResourceManager resource_manager;
+	std::optional<marathon::Wadfile> wadfile;
+	bool may_hold_levels = marathon::ResourceManager::Classify(src) != marathon::ResourceManager::FileKind::Raw;
+
+	if (!resource_manager.Load(src, [&](std::istream& stream,
+										std::streamsize length)
+		{
+			marathon::Wadfile check_wad;
+			if (may_hold_levels &&
+				check_wad.Map(src, stream.tellg(), length) &&
+				check_wad.version() >= 1 &&
+				check_wad.data_version() == 1 &&
+				check_wad.GetWadIndexes().size())
+			{
+				resource_manager.LoadFromWadfile(check_wad);
+				wadfile = std::move(check_wad);
+			}
+		}))
+	{
+		throw split_error("error loading resource or data fork");
+	}
+
+	if (verify && wadfile && !wadfile->VerifyChecksum())
+	{
+		throw split_error(src.string() + ": checksum does not match; the file may be damaged");
+	}
+
+	if (wadfile)
+	{
+		for (const auto& index : wadfile->GetWadIndexes())
+		{
+			bool is_level;
+			try
+			{
+				is_level = wadfile->GetWad(index).HasChunk(marathon::MapInfo::kTag);
+			}
+			catch (const std::exception&)
+			{
+				out << "wad   " << std::setw(5) << index << " (damaged)" << std::endl;
+				continue;
+			}
+
+			if (is_level)
+			{
+				out << "level " << std::setw(5) << index << " "
+					<< mac_roman_to_utf8(wadfile->GetLevelName(index)) << std::endl;
+			}
+		}
+	}
+
+	for (const auto& info : resource_manager.List())
+	{
+		const auto& [res_type, res_index] = info.id;
+		std::string type;
+		for (auto shift = 24; shift >= 0; shift -= 8)
+		{
+			type += static_cast<char>(res_type >> shift);
+		}
+
+		// same as the export folder names: hex for unprintable types
+		if (std::any_of(type.begin(), type.end(), [](char c) { return static_cast<uint8_t>(c) < 0x20; }))
+		{
+			std::ostringstream oss;
+			oss << std::hex << std::setw(8) << std::setfill('0') << res_type;
+			type = oss.str();
+		}
+		else
+		{
+			type = mac_roman_to_utf8(type);
+		}
+
+		out << type << "  " << std::setw(5) << res_index
+			<< " " << std::setw(10) << info.size;
+		if (!info.name.empty())
+		{
+			out << " " << mac_roman_to_utf8(info.name);
 		}
+		out << std::endl;
 	}
 }
@@ -21,20 +21,52 @@
 #ifndef SPLIT_H
 #define SPLIT_H
 
+#include <cstdint>
 #include <filesystem>
+#include <set>
 #include <stdexcept>
 #include <string>
 
 namespace atque 
 {
+class Stats;
+
 class split_error : public std::runtime_error {
 public:
 	split_error(const std::string& what) : std::runtime_error(what) { }
 };
 
+struct split_options {
+	// number of levels written at once
+	int jobs = 1;
+
+	// hard link (or copy) physics, shapes and sounds files that are
+	// identical to an earlier level's, instead of writing them again
+	bool link_duplicates = false;
+
+	// levels to write; empty means all of them
+	std::set<int16_t> levels;
+
+	// whether to export resources (from the resource fork, or Win95
+	// resources in the wadfile)
+	bool resources = true;
+
+	// check the wadfile's CRC before writing anything, and fail if it
+	// does not match; this reads the whole file
+	bool verify = false;
+
+	// if set, where the time goes
+	Stats* stats = nullptr;
+};
+
 void split(const std::filesystem::path& source,
 		   const std::filesystem::path& destination,
-		   std::ostream& log);
+		   std::ostream& log,
+		   const split_options& options = split_options());
+
+// prints the levels and resources in source, without reading (or
+// exporting) their contents; verify checks the CRC first, as in split
+void list(const std::filesystem::path& source, std::ostream& out, bool verify = false);
 };
 
 #endif